@@ -6,6 +6,8 @@
 #import "ABCAccount.h"
 #import "ABCContext+Internal.h"
 
+@class ABCWatcher;
+
 @interface ABCAccount (Internal)
 
 @property (atomic, strong)  ABCContext              *abc;
@@ -18,17 +20,23 @@
 - (void)enterBackground;
 - (void)enterForeground;
 - (BOOL)didLoginExpire;
-- (void)postToGenQRQueue:(void(^)(void))cb;
-- (void)postToMiscQueue:(void(^)(void))cb;
-- (void)postToWatcherQueue:(void(^)(void))cb;
-- (void)postToDataQueue:(void(^)(void))cb;
+- (NSOperation *)postToGenQRQueue:(void(^)(void))cb;
+- (NSOperation *)postToMiscQueue:(void(^)(void))cb;
+- (NSOperation *)postToWatcherQueue:(void(^)(void))cb;
+- (NSOperation *)postToDataQueue:(void(^)(void))cb;
+- (NSOperation *)postToWalletsQueue:(void(^)(void))cb;
+- (void)notifyWalletChanged:(ABCWallet *)wallet;
 - (ABCError *)setDefaultCurrency:(NSString *)currencyCode;
 - (void)setConnectivity:(BOOL)hasConnectivity;
 - (void)setupLoginPIN;
 - (void)refreshWallets;
+- (void)refreshWallet:(NSString *)uuid;
+- (void)markWalletDirty:(NSString *)uuid;
+- (void)requestWalletDataSync:(NSString *)uuid;
 - (void)connectWatcher:(NSString *)uuid;
 - (void)clearDataQueue;
 - (BOOL)watcherExists:(NSString *)uuid;
+- (ABCWatcher *)watcherGet:(NSString *)uuid;
 - (id)initWithCore:(ABCContext *)airbitzCore;
 - (void)free;
 - (void)startQueues;
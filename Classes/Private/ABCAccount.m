@@ -1,14 +1,78 @@
 
 #import "ABCContext+Internal.h"
 #import "ABCAccount.h"
+#import "ABCScheduler.h"
+#import "ABCWatcher.h"
+#import "ABCTransactionTimeline.h"
+#import "ABCBalanceHistory.h"
+#import "ABCTransactionStore.h"
 #import <pthread.h>
 
 static const int   fileSyncFrequencySeconds   = 30;
 static const int64_t recoveryReminderAmount   = 10000000;
 static const int recoveryReminderCount        = 2;
 static const int notifySyncDelay          = 1;
+static const double walletEventCoalesceSeconds = 0.25;
+static const int dataSyncWorkerCountDefault   = 4;
+static const int dataSyncMaxIntervalSeconds   = 600;
+static const double freeTimeoutSeconds        = 10;
+static const NSUInteger maxCachedBalanceHistories = 4;
 static NSNumberFormatter        *numberFormatter = nil;
 
+//
+// Per wallet (and account) data sync bookkeeping. The sync interval starts at
+// fileSyncFrequencySeconds and doubles up to dataSyncMaxIntervalSeconds each time a
+// sync fails or comes back clean. It drops back to the base interval as soon as a
+// sync finds remote changes or the wallet is written to locally.
+//
+@interface ABCWalletSyncState : NSObject
+@property (nonatomic)   int                 failures;
+@property (nonatomic)   NSTimeInterval      interval;
+@property (nonatomic)   CFAbsoluteTime      nextAttempt;
+@end
+
+@implementation ABCWalletSyncState
+
+- (id)init
+{
+    self = [super init];
+    if (self)
+    {
+        self.interval = fileSyncFrequencySeconds;
+        self.nextAttempt = 0;
+    }
+    return self;
+}
+
+- (void)reset
+{
+    self.interval = fileSyncFrequencySeconds;
+    self.nextAttempt = 0;
+}
+
+- (void)recordSyncAt:(CFAbsoluteTime)startTime success:(BOOL)bSuccess dirty:(BOOL)bDirty
+{
+    if (!bSuccess)
+        self.failures++;
+    else
+        self.failures = 0;
+    
+    if (bSuccess && bDirty)
+        self.interval = fileSyncFrequencySeconds;
+    else
+        self.interval = MIN(self.interval * 2, dataSyncMaxIntervalSeconds);
+    self.nextAttempt = startTime + self.interval;
+}
+
+// Allow half a timer tick of slack so a sync that finished just after the
+// previous tick is not pushed out by a whole extra interval
+- (BOOL)isDue:(CFAbsoluteTime)now
+{
+    return self.nextAttempt <= now + fileSyncFrequencySeconds / 2.0;
+}
+
+@end
+
 @interface ABCAccount ()
 {
     ABCError                                        *abcError;
@@ -18,17 +82,24 @@ static NSNumberFormatter        *numberFormatter = nil;
     BOOL                                            bHasSentWalletsLoaded;
     BOOL                                            _bSuspended;
     long                                            iLoginTimeSeconds;
-    NSOperationQueue                                *dataQueue;
-    NSOperationQueue                                *walletsQueue;
-    NSOperationQueue                                *genQRQueue;
-    NSOperationQueue                                *miscQueue;
-    NSOperationQueue                                *watcherQueue;
+    ABCScheduler                                    *scheduler;
+    NSOperation                                     *lastGenQROperation;
     NSLock                                          *watcherLock;
     NSMutableDictionary                             *watchers;
+    NSMutableSet                                    *dirtyWalletUUIDs;
+    BOOL                                            bAllWalletsDirty;
+    BOOL                                            bReloadPending;
+    NSMutableDictionary                             *pendingWalletEvents;
+    NSMutableDictionary                             *pendingWalletEventTimes;
+    BOOL                                            bWalletEventFlushScheduled;
+    NSMutableDictionary                             *walletSyncStates;
+    NSMutableSet                                    *walletsPendingSyncNotify;
+    ABCWalletSyncState                              *accountSyncState;
     
     NSTimer                                         *exchangeTimer;
     NSTimer                                         *dataSyncTimer;
     NSTimer                                         *notificationTimer;
+    dispatch_source_t                               memoryPressureSource;
     
 }
 
@@ -38,6 +109,12 @@ static NSNumberFormatter        *numberFormatter = nil;
 @property (atomic, copy)        NSString            *password;
 @property (atomic, copy)        NSString            *loginKey;
 @property                       NSMutableArray      *walletUUIDsLoaded;
+@property (atomic, strong)      NSDictionary        *walletsByUUID;
+@property (atomic, strong)      ABCTransactionTimeline *timeline;
+@property (atomic, strong)      NSMutableDictionary *balanceHistories;
+@property (atomic, strong)      NSArray             *balanceHistoryStores;
+@property (atomic, strong)      NSData              *balanceHistoryTimestamps;
+@property (atomic, strong)      NSData              *balanceHistoryBalances;
 
 @end
 
@@ -58,21 +135,35 @@ static NSNumberFormatter        *numberFormatter = nil;
         
         abcError = [[ABCError alloc] init];
         
-        dataQueue = [[NSOperationQueue alloc] init];
-        [dataQueue setMaxConcurrentOperationCount:1];
-        walletsQueue = [[NSOperationQueue alloc] init];
-        [walletsQueue setMaxConcurrentOperationCount:1];
-        genQRQueue = [[NSOperationQueue alloc] init];
-        [genQRQueue setMaxConcurrentOperationCount:1];
-        miscQueue = [[NSOperationQueue alloc] init];
-        [miscQueue setMaxConcurrentOperationCount:8];
-        watcherQueue = [[NSOperationQueue alloc] init];
-        [watcherQueue setMaxConcurrentOperationCount:1];
+        scheduler = [[ABCScheduler alloc] init];
         
         watchers = [[NSMutableDictionary alloc] init];
         watcherLock = [[NSLock alloc] init];
+        dirtyWalletUUIDs = [[NSMutableSet alloc] init];
+        bAllWalletsDirty = YES;
+        pendingWalletEvents = [[NSMutableDictionary alloc] init];
+        pendingWalletEventTimes = [[NSMutableDictionary alloc] init];
+        walletSyncStates = [[NSMutableDictionary alloc] init];
+        self.timeline = [[ABCTransactionTimeline alloc] init];
+        self.balanceHistories = [[NSMutableDictionary alloc] init];
+        accountSyncState = [[ABCWalletSyncState alloc] init];
+        walletsPendingSyncNotify = [[NSMutableSet alloc] init];
+        self.dataSyncWorkerCount = dataSyncWorkerCountDefault;
         _walletUUIDsLoaded = [[NSMutableArray alloc] init];
         
+        // Drop idle wallets' transactions when the OS is low on memory
+        __weak ABCAccount *weakSelf = self;
+        memoryPressureSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+                                                      DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+                                                      dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+        dispatch_source_set_event_handler(memoryPressureSource, ^{
+            ABCAccount *account = weakSelf;
+            if (!account) return;
+            unsigned long pressure = dispatch_source_get_data(account->memoryPressureSource);
+            [account evictIdleWalletTransactions:(pressure & DISPATCH_MEMORYPRESSURE_CRITICAL) != 0];
+        });
+        dispatch_resume(memoryPressureSource);
+        
         bInitialized = YES;
         bHasSentWalletsLoaded = NO;
         
@@ -121,18 +212,16 @@ static NSNumberFormatter        *numberFormatter = nil;
     if (YES == bInitialized)
     {
         [self stopQueues];
-        int wait = 0;
-        int maxWait = 200; // ~10 seconds
-        while ([self dataOperationCount] > 0 && wait < maxWait) {
-            [NSThread sleepForTimeInterval:.2];
-            wait++;
-        }
+        if (![scheduler waitUntilIdle:freeTimeoutSeconds])
+            ABCLog(0, @"free: timed out waiting for queues to complete");
         
-        dataQueue = nil;
-        walletsQueue = nil;
-        genQRQueue = nil;
-        miscQueue = nil;
-        watcherQueue = nil;
+        scheduler = nil;
+        lastGenQROperation = nil;
+        if (memoryPressureSource)
+        {
+            dispatch_source_cancel(memoryPressureSource);
+            memoryPressureSource = nil;
+        }
         bInitialized = NO;
         [self cleanWallets];
         self.settings = nil;
@@ -197,60 +286,63 @@ static NSNumberFormatter        *numberFormatter = nil;
         [dataSyncTimer invalidate];
         dataSyncTimer = nil;
     }
-    if (dataQueue)
-        [dataQueue cancelAllOperations];
-    if (walletsQueue)
-        [walletsQueue cancelAllOperations];
-    if (genQRQueue)
-        [genQRQueue cancelAllOperations];
-    if (miscQueue)
-        [miscQueue cancelAllOperations];
-    
+    [scheduler cancelPriority:ABCSchedulerPrioritySync];
+    [scheduler cancelPriority:ABCSchedulerPriorityUIRefresh];
+    [scheduler cancelPriority:ABCSchedulerPriorityInteractive];
 }
 
-- (void)postToDataQueue:(void(^)(void))cb;
+//
+// The postToXQueue: entry points map onto scheduler priority classes:
+//   GenQR, Misc -> Interactive
+//   Wallets     -> UIRefresh
+//   Data        -> Sync
+//   Watcher     -> Background
+//
+- (NSOperation *)postToDataQueue:(void(^)(void))cb;
 {
-    [dataQueue addOperationWithBlock:cb];
+    return [scheduler post:cb priority:ABCSchedulerPrioritySync];
 }
 
-- (void)postToWalletsQueue:(void(^)(void))cb;
+- (NSOperation *)postToWalletsQueue:(void(^)(void))cb;
 {
-    [walletsQueue addOperationWithBlock:cb];
+    return [scheduler post:cb priority:ABCSchedulerPriorityUIRefresh];
 }
 
-- (void)postToGenQRQueue:(void(^)(void))cb;
+- (NSOperation *)postToGenQRQueue:(void(^)(void))cb;
 {
-    [genQRQueue addOperationWithBlock:cb];
+    // Address generation stays serial but no longer waits behind misc work
+    @synchronized(self)
+    {
+        lastGenQROperation = [scheduler post:cb
+                                    priority:ABCSchedulerPriorityInteractive
+                                       after:lastGenQROperation];
+        return lastGenQROperation;
+    }
 }
 
-- (void)postToMiscQueue:(void(^)(void))cb;
+- (NSOperation *)postToMiscQueue:(void(^)(void))cb;
 {
-    [miscQueue addOperationWithBlock:cb];
+    return [scheduler post:cb priority:ABCSchedulerPriorityInteractive];
 }
 
-- (void)postToWatcherQueue:(void(^)(void))cb;
+- (NSOperation *)postToWatcherQueue:(void(^)(void))cb;
 {
-    [watcherQueue addOperationWithBlock:cb];
+    return [scheduler post:cb priority:ABCSchedulerPriorityBackground];
 }
 
 - (int)dataOperationCount
 {
-    int total = 0;
-    total += dataQueue == nil     ? 0 : [dataQueue operationCount];
-    total += walletsQueue == nil  ? 0 : [walletsQueue operationCount];
-    total += genQRQueue == nil  ? 0 : [genQRQueue operationCount];
-    total += watcherQueue == nil  ? 0 : [watcherQueue operationCount];
-    return total;
+    return scheduler == nil ? 0 : (int)[scheduler operationCount];
 }
 
 - (void)clearDataQueue
 {
-    [dataQueue cancelAllOperations];
+    [scheduler cancelPriority:ABCSchedulerPrioritySync];
 }
 
 - (void)clearMiscQueue;
 {
-    [miscQueue cancelAllOperations];
+    [scheduler cancelPriority:ABCSchedulerPriorityInteractive];
 }
 
 // select the wallet with the given UUID
@@ -262,33 +354,8 @@ static NSNumberFormatter        *numberFormatter = nil;
     {
         if ([strUUID length])
         {
-            // If the transaction view is open, close it
-            
-            // look for the wallet in our arrays
-            if (self.arrayWallets)
-            {
-                for (ABCWallet *curWallet in self.arrayWallets)
-                {
-                    if ([strUUID isEqualToString:curWallet.uuid])
-                    {
-                        wallet = curWallet;
-                        break;
-                    }
-                }
-            }
-            
-            // if we haven't found it yet, try the archived wallets
-            if (nil == wallet)
-            {
-                for (ABCWallet *curWallet in self.arrayArchivedWallets)
-                {
-                    if ([strUUID isEqualToString:curWallet.uuid])
-                    {
-                        wallet = curWallet;
-                        break;
-                    }
-                }
-            }
+            // walletsByUUID covers both arrayWallets and arrayArchivedWallets
+            wallet = [self.walletsByUUID objectForKey:strUUID];
         }
     }
     
@@ -341,15 +408,40 @@ static NSNumberFormatter        *numberFormatter = nil;
     ABCLog(2,@"ENTER loadWallets: %@", [NSThread currentThread].name);
     
     NSArray *arrayIDs = [self listWalletIDs];
+    NSSet *dirty;
+    BOOL bAllDirty;
+    @synchronized(dirtyWalletUUIDs)
+    {
+        dirty = [dirtyWalletUUIDs copy];
+        bAllDirty = bAllWalletsDirty;
+        [dirtyWalletUUIDs removeAllObjects];
+        bAllWalletsDirty = NO;
+    }
+    
+    // Only the current wallet gets its transactions loaded up front. The rest are
+    // loaded on first access to arrayTransactions.
+    NSString *currentUUID = self.currentWallet.uuid;
+    
     ABCWallet *wallet;
     for (NSString *uuid in arrayIDs) {
         wallet = [self getWallet:uuid];
         if (!wallet){
             wallet = [[ABCWallet alloc] initWithUser:self];
         }
+        else if (wallet.loaded && !bAllDirty && ![dirty containsObject:uuid]) {
+            // Nothing has changed in this wallet since the last refresh
+            [arrayWallets addObject:wallet];
+            continue;
+        }
         [wallet loadWalletFromCore:uuid];
         if (wallet.loaded) {
-            [wallet loadTransactions];
+            if ([wallet transactionsLoaded])
+                [wallet loadTransactionsIncremental];
+            else if (currentUUID ? [uuid isEqualToString:currentUUID] : !wallet.archived)
+            {
+                [wallet loadTransactionsFromSnapshot];
+                currentUUID = uuid;
+            }
         }
         [arrayWallets addObject:wallet];
     }
@@ -357,8 +449,181 @@ static NSNumberFormatter        *numberFormatter = nil;
     
 }
 
+- (void)evictIdleWalletTransactions
+{
+    [self evictIdleWalletTransactions:NO];
+}
+
+//
+// Releases the transaction arrays of wallets other than the current one. Unless
+// bAll is set, only wallets that have not been read recently are released.
+// They are reloaded on the next access to arrayTransactions.
+//
+- (void)evictIdleWalletTransactions:(BOOL)bAll
+{
+    [self postToWalletsQueue:^{
+        NSString *currentUUID = self.currentWallet.uuid;
+        int evicted = 0;
+        for (ABCWallet *wallet in [self.walletsByUUID allValues])
+        {
+            if ([wallet.uuid isEqualToString:currentUUID])
+                continue;
+            if ([wallet evictTransactionsIfIdle:bAll])
+                evicted++;
+        }
+        ABCLog(1, @"Evicted transactions from %d wallets", evicted);
+        
+        // Let go of the evicted stores held for the merged balance history
+        if (evicted)
+        {
+            @synchronized(self.balanceHistories)
+            {
+                self.balanceHistoryStores = nil;
+                self.balanceHistoryTimestamps = nil;
+                self.balanceHistoryBalances = nil;
+            }
+        }
+    }];
+}
+
+- (int64_t)getTotalSentInLastDays:(NSUInteger)days
+{
+    int64_t total = 0;
+    for (ABCWallet *wallet in [NSArray arrayWithArray:self.arrayWallets])
+        total += [wallet getTotalSentInLastDays:days];
+    return total;
+}
+
+- (int64_t)getTotalSentInLastHours:(double)hours
+{
+    int64_t total = 0;
+    for (ABCWallet *wallet in [NSArray arrayWithArray:self.arrayWallets])
+        total += [wallet getTotalSentInLastHours:hours];
+    return total;
+}
+
+- (NSArray *)searchTransactions:(NSString *)term limit:(NSUInteger)limit
+{
+    NSMutableArray *results = [[NSMutableArray alloc] init];
+    for (ABCWallet *wallet in [NSArray arrayWithArray:self.arrayWallets])
+        [results addObjectsFromArray:[wallet searchTransactions:term limit:limit]];
+    [results sortUsingComparator:^NSComparisonResult(ABCTransaction *a, ABCTransaction *b) {
+        return [b.date compare:a.date];
+    }];
+    if (limit && [results count] > limit)
+        [results removeObjectsInRange:NSMakeRange(limit, [results count] - limit)];
+    return results;
+}
+
+- (NSArray *)getTimelineOffset:(NSUInteger)offset
+                         limit:(NSUInteger)limit
+                        filter:(ABCTimelineFilter *)filter
+{
+    NSMutableArray *wallets = [NSMutableArray arrayWithArray:self.arrayWallets];
+    if (filter.includeArchived && self.arrayArchivedWallets)
+        [wallets addObjectsFromArray:self.arrayArchivedWallets];
+    return [self.timeline transactionsForWallets:wallets offset:offset limit:limit filter:filter];
+}
+
+//
+// Merges the wallets' newest first columns into one list with the running total of
+// all wallets. Entries with equal timestamps keep their order within a wallet and
+// are taken in wallet order across wallets, so the balance at a tie is always the
+// same. The result is kept until one of the wallets installs a new store.
+//
+- (void)mergeBalanceColumns:(NSArray *)stores
+{
+    if ([stores isEqualToArray:self.balanceHistoryStores])
+        return;
+    
+    NSUInteger k = [stores count];
+    NSUInteger count = 0;
+    int64_t total = 0;
+    for (ABCTransactionStore *store in stores)
+    {
+        count += store.count;
+        total += store.balances[0];
+    }
+    NSMutableData *timestamps = [NSMutableData dataWithLength:count * sizeof(int64_t)];
+    NSMutableData *balances = [NSMutableData dataWithLength:count * sizeof(int64_t)];
+    int64_t *ts = [timestamps mutableBytes];
+    int64_t *bal = [balances mutableBytes];
+    NSUInteger *next = calloc(k ? k : 1, sizeof(NSUInteger));
+    
+    // Wallet counts are small, so a linear scan for the newest head is enough
+    for (NSUInteger n = 0; n < count; n++)
+    {
+        NSUInteger best = k;
+        int64_t bestTime = 0;
+        for (NSUInteger w = 0; w < k; w++)
+        {
+            ABCTransactionStore *store = stores[w];
+            if (next[w] < store.count && (best == k || store.timestamps[next[w]] > bestTime))
+            {
+                best = w;
+                bestTime = store.timestamps[next[w]];
+            }
+        }
+        ABCTransactionStore *store = stores[best];
+        ts[n] = bestTime;
+        bal[n] = total;
+        total -= store.amounts[next[best]];
+        next[best]++;
+    }
+    free(next);
+    
+    self.balanceHistoryStores = stores;
+    self.balanceHistoryTimestamps = timestamps;
+    self.balanceHistoryBalances = balances;
+}
+
+- (NSArray *)getBalanceHistoryFrom:(NSDate *)start to:(NSDate *)end interval:(NSTimeInterval)interval
+{
+    if (!start || interval < 1)
+        return [[NSArray alloc] init];
+    int64_t startTime = (int64_t) [start timeIntervalSince1970];
+    int64_t endTime = (int64_t) [(end ? end : [NSDate date]) timeIntervalSince1970];
+    if (endTime <= startTime)
+        return [[NSArray alloc] init];
+    int64_t bucketInterval = [ABCBalanceHistory intervalForStart:startTime end:endTime interval:(int64_t) interval];
+    
+    NSMutableArray *stores = [[NSMutableArray alloc] init];
+    // Wallets whose transactions are still loading are left out until
+    // abcAccountWalletChanged: reports them loaded
+    for (ABCWallet *wallet in [NSArray arrayWithArray:self.arrayWallets])
+    {
+        [wallet arrayTransactions];
+        ABCTransactionStore *store = wallet.transactionStore;
+        if (!store.count) continue;
+        [stores addObject:store];
+    }
+    
+    NSString *key = [NSString stringWithFormat:@"%lld:%lld", startTime, bucketInterval];
+    ABCBalanceHistory *history;
+    @synchronized(self.balanceHistories)
+    {
+        [self mergeBalanceColumns:stores];
+        history = [self.balanceHistories objectForKey:key];
+        if (!history)
+        {
+            if ([self.balanceHistories count] >= maxCachedBalanceHistories)
+                [self.balanceHistories removeAllObjects];
+            history = [[ABCBalanceHistory alloc] initWithStart:startTime interval:bucketInterval];
+            [self.balanceHistories setObject:history forKey:key];
+        }
+        [history updateWithTimestamps:[self.balanceHistoryTimestamps bytes]
+                             balances:[self.balanceHistoryBalances bytes]
+                                count:[self.balanceHistoryTimestamps length] / sizeof(int64_t)];
+    }
+    return [history pointsTo:endTime];
+}
+
 - (void)makeCurrentWallet:(ABCWallet *)wallet
 {
+    // Load the new current wallet's transactions before the GUI asks for them
+    if (wallet && ![wallet transactionsLoaded])
+        [wallet loadTransactionsAsync];
+
     if ([self.arrayWallets containsObject:wallet])
     {
         self.currentWallet = wallet;
@@ -419,103 +684,150 @@ static NSNumberFormatter        *numberFormatter = nil;
     self.arrayWallets = nil;
     self.arrayArchivedWallets = nil;
     self.arrayWalletNames = nil;
+    self.walletsByUUID = nil;
+    self.timeline = [[ABCTransactionTimeline alloc] init];
+    self.balanceHistories = [[NSMutableDictionary alloc] init];
+    self.balanceHistoryStores = nil;
+    self.balanceHistoryTimestamps = nil;
+    self.balanceHistoryBalances = nil;
     self.currentWallet = nil;
     self.currentWalletIndex = 0;
     self.numWalletsLoaded = 0;
     self.numTotalWallets = 0;
     self.bAllWalletsLoaded = NO;
+    [self markAllWalletsDirty];
 }
 
 
-- (void)refreshWalletsIfNotBusy:(void(^)(void))cb
+- (void)markWalletDirty:(NSString *)uuid;
 {
-    if (0 == [walletsQueue operationCount])
-        [self refreshWallets:cb];
-    else
-        ABCLog(2, @"refreshWallets BUSY");
+    if (!uuid)
+        return;
+    @synchronized(dirtyWalletUUIDs)
+    {
+        [dirtyWalletUUIDs addObject:uuid];
+    }
+}
+
+- (void)markAllWalletsDirty;
+{
+    @synchronized(dirtyWalletUUIDs)
+    {
+        bAllWalletsDirty = YES;
+    }
+}
+
+- (void)refreshWallet:(NSString *)uuid;
+{
+    [self markWalletDirty:uuid];
+    [self reloadWallets:nil];
 }
 
 - (void)refreshWallets;
 {
-    if (0 == [walletsQueue operationCount])
-        [self refreshWallets:nil];
-    else
-        ABCLog(2, @"refreshWallets BUSY");
+    [self markAllWalletsDirty];
+    [self reloadWallets:nil];
 }
 
 - (void)refreshWallets:(void(^)(void))cb
 {
-    [self postToWatcherQueue:^{
-        [self postToWalletsQueue:^(void) {
-            ABCLog(2,@"ENTER refreshWallets WalletQueue: %@", [NSThread currentThread].name);
-            NSMutableArray *arrayWallets = [[NSMutableArray alloc] init];
-            NSMutableArray *arrayArchivedWallets = [[NSMutableArray alloc] init];
-            NSMutableArray *arrayWalletNames = [[NSMutableArray alloc] init];
-            
-            [self loadWallets:arrayWallets archived:arrayArchivedWallets];
+    [self markAllWalletsDirty];
+    [self reloadWallets:cb];
+}
+
+//
+// Reloads wallets flagged with markWalletDirty. A reload without a callback is skipped
+// if another one is queued but not yet started since that one will pick up the
+// same dirty flags.
+//
+- (void)reloadWallets:(void(^)(void))cb
+{
+    @synchronized(dirtyWalletUUIDs)
+    {
+        if (bReloadPending && !cb)
+        {
+            ABCLog(2, @"refreshWallets already pending");
+            return;
+        }
+        bReloadPending = YES;
+    }
+    [self postToWalletsQueue:^(void) {
+        ABCLog(2,@"ENTER refreshWallets WalletQueue: %@", [NSThread currentThread].name);
+        @synchronized(dirtyWalletUUIDs)
+        {
+            bReloadPending = NO;
+        }
+        NSMutableArray *arrayWallets = [[NSMutableArray alloc] init];
+        NSMutableArray *arrayArchivedWallets = [[NSMutableArray alloc] init];
+        NSMutableArray *arrayWalletNames = [[NSMutableArray alloc] init];
+        
+        [self loadWallets:arrayWallets archived:arrayArchivedWallets];
+        
+        //
+        // Update wallet names for various dropdowns
+        //
+        int loadingCount = 0;
+        NSMutableDictionary *walletsByUUID = [[NSMutableDictionary alloc] init];
+        for (int i = 0; i < [arrayWallets count]; i++)
+        {
+            ABCWallet *wallet = [arrayWallets objectAtIndex:i];
+            [walletsByUUID setObject:wallet forKey:wallet.uuid];
+            [arrayWalletNames addObject:[NSString stringWithFormat:@"%@ (%@)", wallet.name,
+                                         [self.settings.denomination satoshiToBTCString:wallet.balance]]];
+            if (!wallet.loaded) {
+                loadingCount++;
+            }
+        }
+        
+        for (int i = 0; i < [arrayArchivedWallets count]; i++)
+        {
+            ABCWallet *wallet = [arrayArchivedWallets objectAtIndex:i];
+            [walletsByUUID setObject:wallet forKey:wallet.uuid];
+            if (!wallet.loaded) {
+                loadingCount++;
+            }
+        }
+        
+        dispatch_async(dispatch_get_main_queue(),^{
+            ABCLog(2,@"ENTER refreshWallets MainQueue: %@", [NSThread currentThread].name);
+            self.arrayWallets = arrayWallets;
+            self.arrayArchivedWallets = arrayArchivedWallets;
+            self.arrayWalletNames = arrayWalletNames;
+            self.walletsByUUID = walletsByUUID;
+            self.numTotalWallets = (int) ([arrayWallets count] + [arrayArchivedWallets count]);
+            self.numWalletsLoaded = self.numTotalWallets  - loadingCount;
             
-            //
-            // Update wallet names for various dropdowns
-            //
-            int loadingCount = 0;
-            for (int i = 0; i < [arrayWallets count]; i++)
+            if (loadingCount == 0)
             {
-                ABCWallet *wallet = [arrayWallets objectAtIndex:i];
-                [arrayWalletNames addObject:[NSString stringWithFormat:@"%@ (%@)", wallet.name,
-                                             [self.settings.denomination satoshiToBTCString:wallet.balance]]];
-                if (!wallet.loaded) {
-                    loadingCount++;
-                }
+                self.bAllWalletsLoaded = YES;
             }
-            
-            for (int i = 0; i < [arrayArchivedWallets count]; i++)
+            else
             {
-                ABCWallet *wallet = [arrayArchivedWallets objectAtIndex:i];
-                if (!wallet.loaded) {
-                    loadingCount++;
-                }
+                self.bAllWalletsLoaded = NO;
             }
             
-            dispatch_async(dispatch_get_main_queue(),^{
-                ABCLog(2,@"ENTER refreshWallets MainQueue: %@", [NSThread currentThread].name);
-                self.arrayWallets = arrayWallets;
-                self.arrayArchivedWallets = arrayArchivedWallets;
-                self.arrayWalletNames = arrayWalletNames;
-                self.numTotalWallets = (int) ([arrayWallets count] + [arrayArchivedWallets count]);
-                self.numWalletsLoaded = self.numTotalWallets  - loadingCount;
-                
-                if (loadingCount == 0)
-                {
-                    self.bAllWalletsLoaded = YES;
-                }
-                else
-                {
-                    self.bAllWalletsLoaded = NO;
-                }
-                
-                if (nil == self.currentWallet)
-                {
-                    if ([self.arrayWallets count] > 0)
-                    {
-                        self.currentWallet = [arrayWallets objectAtIndex:0];
-                    }
-                    self.currentWalletIndex = 0;
-                }
-                else
+            if (nil == self.currentWallet)
+            {
+                if ([self.arrayWallets count] > 0)
                 {
-                    NSString *lastCurrentWalletUUID = self.currentWallet.uuid;
-                    self.currentWallet = [self selectWalletWithUUID:lastCurrentWalletUUID];
-                    self.currentWalletIndex = (int) [self.arrayWallets indexOfObject:self.currentWallet];
+                    self.currentWallet = [arrayWallets objectAtIndex:0];
                 }
-                [self postNotificationWalletsChanged];
-                
-                ABCLog(2,@"EXIT refreshWallets MainQueue: %@", [NSThread currentThread].name);
-                
-                if (cb) cb();
-                
-            });
-            ABCLog(2,@"EXIT refreshWallets WalletQueue: %@", [NSThread currentThread].name);
-        }];
+                self.currentWalletIndex = 0;
+            }
+            else
+            {
+                NSString *lastCurrentWalletUUID = self.currentWallet.uuid;
+                self.currentWallet = [self selectWalletWithUUID:lastCurrentWalletUUID];
+                self.currentWalletIndex = (int) [self.arrayWallets indexOfObject:self.currentWallet];
+            }
+            [self postNotificationWalletsChanged];
+            
+            ABCLog(2,@"EXIT refreshWallets MainQueue: %@", [NSThread currentThread].name);
+            
+            if (cb) cb();
+            
+        });
+        ABCLog(2,@"EXIT refreshWallets WalletQueue: %@", [NSThread currentThread].name);
     }];
 }
 
@@ -565,17 +877,9 @@ static NSNumberFormatter        *numberFormatter = nil;
 
 - (ABCWallet *)getWallet: (NSString *)walletUUID
 {
-    for (ABCWallet *wallet in self.arrayWallets)
-    {
-        if ([wallet.uuid isEqualToString:walletUUID])
-            return wallet;
-    }
-    for (ABCWallet *wallet in self.arrayArchivedWallets)
-    {
-        if ([wallet.uuid isEqualToString:walletUUID])
-            return wallet;
-    }
-    return nil;
+    if (!walletUUID)
+        return nil;
+    return [self.walletsByUUID objectForKey:walletUUID];
 }
 
 #if TARGET_OS_IPHONE
@@ -793,16 +1097,13 @@ static NSNumberFormatter        *numberFormatter = nil;
     //
     [self postToWatcherQueue: ^
      {
-         // Goes to dataQueue after watcherQueue is complete from above
-         [self dataSyncAllWalletsAndAccount];
-         
          //
          // Start the watchers to grab new blockchain transaction data. Do this AFTER git sync
          // So that new transactions will have proper meta data if other devices already tagged them
          //
-         [self postToDataQueue:^
+         [self dataSyncAllWalletsAndAccount:^(ABCDataSyncStats *stats)
           {
-              // Goes to watcherQueue after dataQueue is complete from above
+              // Goes to watcherQueue after the sync cycle is complete
               [self connectWatchers];
           }];
      }];
@@ -812,7 +1113,8 @@ static NSNumberFormatter        *numberFormatter = nil;
     //
     [self postToWatcherQueue: ^
      {
-         // Starts only after connectWatchers finishes from watcherQueue
+         // Runs once the data sync cycle above has been started. It does not wait for
+         // the cycle or for connectWatchers, which runs from the cycle's completion.
          [self startQueues];
          
          iLoginTimeSeconds = [self saveLogoutDate];
@@ -872,9 +1174,10 @@ static NSNumberFormatter        *numberFormatter = nil;
             ABCError *nserror = [ABCError makeNSError:error];
             if (nserror)
                 ABCLog(1, @"ABC_WalletLoad ERROR Loading Wallet %@ %@", nserror.userInfo[NSLocalizedDescriptionKey], nserror.userInfo[NSLocalizedFailureReasonErrorKey]);
+            // Refresh once this wallet is loaded so it shows up before the rest
+            [self refreshWallet:uuid];
         }];
         [self startWatcher:uuid];
-        [self refreshWallets]; // Also goes to watcher queue.
     }
 }
 
@@ -882,25 +1185,14 @@ static NSNumberFormatter        *numberFormatter = nil;
 {
     [self stopQueues];
     
-    unsigned long wq, gq, dq, eq, mq;
-    
-//    // XXX: prevents crashing on logout
-    while (YES)
-    {
-        wq = (unsigned long)[walletsQueue operationCount];
-        dq = (unsigned long)[dataQueue operationCount];
-        gq = (unsigned long)[genQRQueue operationCount];
-        mq = (unsigned long)[miscQueue operationCount];
-        
-        //        if (0 == (wq + dq + gq + txq + eq + mq + lq))
-        if (0 == (wq + gq + mq))
-            break;
-        
-        ABCLog(0,
-               @"Waiting for queues to complete wq=%lu dq=%lu gq=%lu mq=%lu",
-               wq, dq, gq, mq);
-        [NSThread sleepForTimeInterval:.2];
-    }
+    // XXX: prevents crashing on logout. Returns as soon as the in-flight
+    // wallet and interactive operations finish.
+    ABCLog(1, @"Waiting for queues to complete wq=%lu dq=%lu iq=%lu",
+           (unsigned long)[scheduler operationCountForPriority:ABCSchedulerPriorityUIRefresh],
+           (unsigned long)[scheduler operationCountForPriority:ABCSchedulerPrioritySync],
+           (unsigned long)[scheduler operationCountForPriority:ABCSchedulerPriorityInteractive]);
+    [scheduler waitUntilIdle:@[@(ABCSchedulerPriorityUIRefresh), @(ABCSchedulerPriorityInteractive)]
+                     timeout:-1];
     
     [self stopWatchers];
     [self cleanWallets];
@@ -1026,18 +1318,18 @@ static NSNumberFormatter        *numberFormatter = nil;
     return exists;
 }
 
-- (NSOperationQueue *)watcherGet:(NSString *)uuid
+- (ABCWatcher *)watcherGet:(NSString *)uuid
 {
     [watcherLock lock];
-    NSOperationQueue *queue = [watchers objectForKey:uuid];
+    ABCWatcher *watcher = [watchers objectForKey:uuid];
     [watcherLock unlock];
-    return queue;
+    return watcher;
 }
 
-- (void)watcherSet:(NSString *)uuid queue:(NSOperationQueue *)queue
+- (void)watcherSet:(NSString *)uuid watcher:(ABCWatcher *)watcher
 {
     [watcherLock lock];
-    [watchers setObject:queue forKey:uuid];
+    [watchers setObject:watcher forKey:uuid];
     [watcherLock unlock];
 }
 
@@ -1058,10 +1350,9 @@ static NSNumberFormatter        *numberFormatter = nil;
                              [self.password UTF8String],
                              szUUID, &Error);
             
-            NSOperationQueue *queue = [[NSOperationQueue alloc] init];
-            [self watcherSet:walletUUID queue:queue];
-            [queue addOperationWithBlock:^{
-                [queue setName:walletUUID];
+            ABCWatcher *watcher = [[ABCWatcher alloc] initWithUUID:walletUUID];
+            [self watcherSet:walletUUID watcher:watcher];
+            [watcher start:^{
                 tABC_Error Error;
                 ABC_WatcherLoop([walletUUID UTF8String],
                                 ABC_BitCoin_Event_Callback,
@@ -1076,19 +1367,19 @@ static NSNumberFormatter        *numberFormatter = nil;
 {
     NSArray *arrayIDs = [self listWalletIDs];
     // stop watchers
-    [self postToWatcherQueue: ^{
+    NSOperation *op = [self postToWatcherQueue: ^{
         for (NSString *uuid in arrayIDs) {
             tABC_Error Error;
             ABC_WatcherStop([uuid UTF8String], &Error);
         }
         // wait for threads to finish
         for (NSString *uuid in arrayIDs) {
-            NSOperationQueue *queue = [self watcherGet:uuid];
-            if (queue == nil) {
+            ABCWatcher *watcher = [self watcherGet:uuid];
+            if (watcher == nil) {
                 continue;
             }
-            // Wait until operations complete
-            [queue waitUntilAllOperationsAreFinished];
+            // Wait until the watcher loop returns
+            [watcher waitUntilFinished:-1];
             // Remove the watcher from the dictionary
             [self watcherRemove:uuid];
         }
@@ -1099,7 +1390,8 @@ static NSNumberFormatter        *numberFormatter = nil;
         }
     }];
     
-    while ([watcherQueue operationCount]);
+    // The watcher queue is serial so this also covers anything posted before us
+    [op waitUntilFinished];
 }
 
 - (void)requestExchangeRateUpdate
@@ -1125,33 +1417,114 @@ static NSNumberFormatter        *numberFormatter = nil;
     [self.exchangeCache updateExchangeCache];
 }
 
-- (void)requestWalletDataSync:(ABCWallet *)wallet;
+//
+// Runs ABC_DataSyncWallet for one wallet on the calling thread and updates its
+// sync interval. Returns YES if the sync succeeded.
+//
+- (BOOL)syncWalletData:(ABCWallet *)wallet bDirty:(bool *)pbDirty
 {
-    [dataQueue addOperationWithBlock:^{
-        tABC_Error error;
-        bool bDirty = false;
-        ABC_DataSyncWallet([self.name UTF8String],
-                           [self.password UTF8String],
-                           [wallet.uuid UTF8String],
-                           &bDirty,
-                           &error);
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    tABC_Error error;
+    bool bDirty = false;
+    ABC_DataSyncWallet([self.name UTF8String],
+                       [self.password UTF8String],
+                       [wallet.uuid UTF8String],
+                       &bDirty,
+                       &error);
+    ABCError *nserror = [ABCError makeNSError:error];
+    ABCWalletSyncState *state = [self syncStateForWallet:wallet.uuid];
+    @synchronized(walletSyncStates)
+    {
+        [state recordSyncAt:startTime success:(nserror == nil) dirty:bDirty];
+        if (nserror)
+            ABCLog(1, @"ABC_DataSyncWallet failed %@ retry in %.0fs", wallet.uuid, state.interval);
+    }
+    if (bDirty)
+    {
         dispatch_async(dispatch_get_main_queue(), ^ {
-            if (bDirty) {
-                [self notifyWalletSyncDelayed:wallet];
-            }
+            [self notifyWalletSyncDelayed:wallet];
         });
+    }
+    if (pbDirty) *pbDirty = bDirty;
+    return nserror == nil;
+}
+
+- (ABCWalletSyncState *)syncStateForWallet:(NSString *)uuid
+{
+    @synchronized(walletSyncStates)
+    {
+        ABCWalletSyncState *state = [walletSyncStates objectForKey:uuid];
+        if (!state)
+        {
+            state = [[ABCWalletSyncState alloc] init];
+            [walletSyncStates setObject:state forKey:uuid];
+        }
+        return state;
+    }
+}
+
+//
+// Called after a local write to a wallet. Resets its sync interval and pushes
+// the change out right away.
+//
+- (void)requestWalletDataSync:(NSString *)uuid
+{
+    if (!uuid) return;
+    @synchronized(walletSyncStates)
+    {
+        [[self syncStateForWallet:uuid] reset];
+    }
+    ABCWallet *wallet = [self getWallet:uuid];
+    if (!wallet) return;
+    [self postToDataQueue:^{
+        if ([self isLoggedIn])
+            [self syncWalletData:wallet bDirty:NULL];
     }];
 }
 
+- (NSTimeInterval)dataSyncIntervalForWallet:(NSString *)uuid
+{
+    @synchronized(walletSyncStates)
+    {
+        ABCWalletSyncState *state = [walletSyncStates objectForKey:uuid];
+        return state ? state.interval : fileSyncFrequencySeconds;
+    }
+}
+
+- (NSTimeInterval)dataSyncIntervalForAccount
+{
+    @synchronized(walletSyncStates)
+    {
+        return accountSyncState.interval;
+    }
+}
+
 - (void)notifyWalletSync:(NSTimer *)timer;
 {
-    ABCWallet *wallet = [timer userInfo];
+    NSArray *wallets;
+    @synchronized(walletsPendingSyncNotify)
+    {
+        wallets = [walletsPendingSyncNotify allObjects];
+        [walletsPendingSyncNotify removeAllObjects];
+    }
+    // Reload off the main thread, then tell the GUI
+    [self postToWalletsQueue:^{
+        for (ABCWallet *wallet in wallets)
+        {
+            if ([wallet transactionsLoaded])
+                [wallet loadTransactions];
+            [self notifyWalletChanged:wallet];
+        }
+    }];
+}
+
+- (void)notifyWalletChanged:(ABCWallet *)wallet;
+{
     if (self.delegate)
     {
         if ([self.delegate respondsToSelector:@selector(abcAccountWalletChanged:)])
         {
             dispatch_async(dispatch_get_main_queue(), ^{
-                [wallet loadTransactions];
                 [self.delegate abcAccountWalletChanged:wallet];
             });
         }
@@ -1160,6 +1533,12 @@ static NSNumberFormatter        *numberFormatter = nil;
 
 - (void)notifyWalletSyncDelayed:(ABCWallet *)wallet;
 {
+    // Collect every wallet that changed so a burst of parallel syncs
+    // notifies each of them once instead of only the last one
+    @synchronized(walletsPendingSyncNotify)
+    {
+        [walletsPendingSyncNotify addObject:wallet];
+    }
     if (notificationTimer) {
         [notificationTimer invalidate];
     }
@@ -1167,14 +1546,28 @@ static NSNumberFormatter        *numberFormatter = nil;
     notificationTimer = [NSTimer scheduledTimerWithTimeInterval:notifySyncDelay
                                                               target:self
                                                             selector:@selector(notifyWalletSync:)
-                                                            userInfo:wallet
+                                                            userInfo:nil
                                                              repeats:NO];
 }
 
+//
+// Called after a local write to the account repo. Resets the account sync
+// interval and syncs right away.
+//
 - (void)dataSyncAccount;
+{
+    @synchronized(walletSyncStates)
+    {
+        [accountSyncState reset];
+    }
+    [self postAccountDataSync];
+}
+
+- (void)postAccountDataSync
 {
     [self postToDataQueue:^{
         [[NSThread currentThread] setName:@"Data Sync"];
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
         tABC_Error error;
         bool bDirty = false;
         bool bPasswordChanged = false;
@@ -1184,6 +1577,10 @@ static NSNumberFormatter        *numberFormatter = nil;
                             &bPasswordChanged,
                             &error);
         ABCError *nserror = [ABCError makeNSError:error];
+        @synchronized(walletSyncStates)
+        {
+            [accountSyncState recordSyncAt:startTime success:(nserror == nil) dirty:bDirty];
+        }
         if (ABCConditionCodeInvalidOTP == nserror.code)
         {
             NSString *key = nil;
@@ -1225,32 +1622,101 @@ static NSNumberFormatter        *numberFormatter = nil;
 
 
 - (void)dataSyncAllWalletsAndAccount
+{
+    [self dataSyncAllWalletsAndAccount:nil];
+}
+
+//
+// Syncs all wallets using up to dataSyncWorkerCount parallel workers, then the account,
+// then general info. complete is called from the sync queue once the cycle is done.
+//
+- (void)dataSyncAllWalletsAndAccount:(void(^)(ABCDataSyncStats *stats))complete
 {
     // Do not request a sync one is currently in progress
-    if ([dataQueue operationCount] > 0) {
+    if ([scheduler operationCountForPriority:ABCSchedulerPrioritySync] > 0) {
+        if (complete)
+            [self postToDataQueue:^{ complete(nil); }];
         return;
     }
-
     
     // Sync Wallets First
-    NSArray *arrayWallets = [NSArray arrayWithArray:self.arrayWallets];
-    NSArray *arrayArchivedWallets = [NSArray arrayWithArray:self.arrayArchivedWallets];
-    for (ABCWallet *wallet in arrayWallets)
-    {
-        [self requestWalletDataSync:wallet];
-    }
-    for (ABCWallet *wallet in arrayArchivedWallets)
-    {
-        [self requestWalletDataSync:wallet];
-    }
+    NSMutableArray *wallets = [NSMutableArray arrayWithArray:self.arrayWallets];
+    [wallets addObjectsFromArray:self.arrayArchivedWallets];
+    
+    ABCDataSyncStats *stats = [[ABCDataSyncStats alloc] init];
+    __block CFAbsoluteTime startTime;
+    __block __weak NSOperation *cycleOp = nil;
+    
+    // cycleOp must be set before the operation can start, so build it and only then queue it
+    NSBlockOperation *op = [NSBlockOperation blockOperationWithBlock:^{
+        [[NSThread currentThread] setName:@"Data Sync"];
+        startTime = CFAbsoluteTimeGetCurrent();
+        
+        int workers = MAX(1, self.dataSyncWorkerCount);
+        stats.workerCount = workers;
+        dispatch_semaphore_t sem = dispatch_semaphore_create(workers);
+        dispatch_group_t group = dispatch_group_create();
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+        
+        for (ABCWallet *wallet in wallets)
+        {
+            // Stop handing out work once stopQueues cancels the sync queue
+            if (![self isLoggedIn] || cycleOp.isCancelled)
+                break;
+            
+            ABCWalletSyncState *state = [self syncStateForWallet:wallet.uuid];
+            BOOL bDue;
+            @synchronized(walletSyncStates)
+            {
+                bDue = [state isDue:CFAbsoluteTimeGetCurrent()];
+            }
+            if (!bDue)
+            {
+                @synchronized(stats) { stats.walletsSkipped++; }
+                continue;
+            }
+            
+            dispatch_semaphore_wait(sem, DISPATCH_TIME_FOREVER);
+            dispatch_group_async(group, queue, ^{
+                bool bDirty = false;
+                BOOL bSuccess = [self syncWalletData:wallet bDirty:&bDirty];
+                @synchronized(stats)
+                {
+                    if (bSuccess)
+                        stats.walletsSynced++;
+                    else
+                        stats.walletsFailed++;
+                    if (bDirty)
+                        stats.walletsDirty++;
+                }
+                dispatch_semaphore_signal(sem);
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+    }];
+    cycleOp = op;
+    [scheduler addOperation:op priority:ABCSchedulerPrioritySync];
     
     // Sync Account second
-    [self dataSyncAccount];
+    BOOL bAccountDue;
+    @synchronized(walletSyncStates)
+    {
+        bAccountDue = [accountSyncState isDue:CFAbsoluteTimeGetCurrent()];
+    }
+    if (bAccountDue)
+        [self postAccountDataSync];
     
     // Fetch general info last
-    [dataQueue addOperationWithBlock:^{
+    [self postToDataQueue:^{
         tABC_Error error;
         ABC_GeneralInfoUpdate(&error);
+        
+        stats.wallTime = CFAbsoluteTimeGetCurrent() - startTime;
+        self.lastDataSyncStats = stats;
+        ABCLog(1, @"Data sync: %d synced %d dirty %d failed %d skipped, %d workers, %.2fs",
+               stats.walletsSynced, stats.walletsDirty, stats.walletsFailed,
+               stats.walletsSkipped, stats.workerCount, stats.wallTime);
+        if (complete) complete(stats);
     }];
     
     [self startDataSyncTimer];
@@ -1439,6 +1905,163 @@ static NSNumberFormatter        *numberFormatter = nil;
 
 
 
+#pragma mark - Watcher event coalescing
+
+//
+// Watcher events are batched per wallet for walletEventCoalesceSeconds. Duplicate
+// (type, txid) pairs are dropped. Each window produces a single reload of the dirty
+// wallets followed by one pass over the delegate on the main queue.
+//
+- (void)queueWalletEvent:(int)type wallet:(NSString *)uuid txid:(NSString *)txid
+{
+    if (ABC_AsyncEventType_BlockHeightChange == type)
+    {
+        ABCWallet *wallet = [self getWallet:uuid];
+        wallet.bBlockHeightChanged = YES;
+    }
+    
+    @synchronized(pendingWalletEvents)
+    {
+        NSMutableOrderedSet *events = [pendingWalletEvents objectForKey:uuid];
+        if (!events)
+        {
+            events = [[NSMutableOrderedSet alloc] init];
+            [pendingWalletEvents setObject:events forKey:uuid];
+            [pendingWalletEventTimes setObject:[NSNumber numberWithDouble:CFAbsoluteTimeGetCurrent()] forKey:uuid];
+        }
+        [events addObject:@[[NSNumber numberWithInt:type], txid ? txid : @""]];
+        
+        if (!bWalletEventFlushScheduled)
+        {
+            bWalletEventFlushScheduled = YES;
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(walletEventCoalesceSeconds * NSEC_PER_SEC)),
+                           dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                               [self flushWalletEvents];
+                           });
+        }
+    }
+}
+
+- (void)flushWalletEvents
+{
+    NSDictionary *events;
+    NSDictionary *times;
+    @synchronized(pendingWalletEvents)
+    {
+        events = [pendingWalletEvents copy];
+        times = [pendingWalletEventTimes copy];
+        [pendingWalletEvents removeAllObjects];
+        [pendingWalletEventTimes removeAllObjects];
+        bWalletEventFlushScheduled = NO;
+    }
+    if (![self isLoggedIn] || [events count] == 0)
+        return;
+    
+    BOOL bNeedsReload = NO;
+    for (NSString *uuid in events)
+    {
+        for (NSArray *event in [events objectForKey:uuid])
+        {
+            if (ABC_AsyncEventType_BlockHeightChange != [event[0] intValue])
+            {
+                [self markWalletDirty:uuid];
+                bNeedsReload = YES;
+            }
+        }
+    }
+    
+    void (^notify)(void) = ^{
+        [self notifyWalletEvents:events];
+        [self recordWalletEventLatency:times];
+    };
+    
+    if (bNeedsReload)
+        [self reloadWallets:notify];
+    else
+        dispatch_async(dispatch_get_main_queue(), notify);
+}
+
+// Latency is measured from the first event of a batch to its delegate delivery
+- (void)recordWalletEventLatency:(NSDictionary *)times
+{
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    for (NSString *uuid in times)
+    {
+        NSTimeInterval latency = now - [[times objectForKey:uuid] doubleValue];
+        ABCWatcher *watcher = [self watcherGet:uuid];
+        [watcher recordEventLatency:latency];
+        ABCLog(2, @"Watcher event latency %@ %.3fs (avg %.3fs max %.3fs)",
+               uuid, latency, watcher.averageEventLatency, watcher.maxEventLatency);
+    }
+}
+
+- (void)notifyWalletEvents:(NSDictionary *)events
+{
+    if (!self.delegate)
+        return;
+    
+    if ([self.delegate respondsToSelector:@selector(abcAccountWalletEvents:)])
+    {
+        NSMutableArray *batch = [[NSMutableArray alloc] initWithCapacity:[events count]];
+        for (NSString *uuid in events)
+        {
+            ABCWallet *wallet = [self getWallet:uuid];
+            if (!wallet)
+                continue;
+            ABCWalletEvents *walletEvents = [[ABCWalletEvents alloc] init];
+            NSMutableArray *incoming = [[NSMutableArray alloc] init];
+            NSMutableArray *balanceUpdates = [[NSMutableArray alloc] init];
+            walletEvents.wallet = wallet;
+            for (NSArray *event in [events objectForKey:uuid])
+            {
+                int type = [event[0] intValue];
+                ABCTransaction *tx = [event[1] length] ? [wallet getTransaction:event[1]] : nil;
+                if (ABC_AsyncEventType_IncomingBitCoin == type && tx)
+                    [incoming addObject:tx];
+                else if (ABC_AsyncEventType_BalanceUpdate == type && tx)
+                    [balanceUpdates addObject:tx];
+                else if (ABC_AsyncEventType_BlockHeightChange == type)
+                    walletEvents.blockHeightChanged = YES;
+                else if (ABC_AsyncEventType_TransactionUpdate == type)
+                    walletEvents.transactionsUpdated = YES;
+            }
+            walletEvents.incomingTransactions = incoming;
+            walletEvents.balanceUpdateTransactions = balanceUpdates;
+            [batch addObject:walletEvents];
+        }
+        if ([batch count])
+            [self.delegate abcAccountWalletEvents:batch];
+        return;
+    }
+    
+    for (NSString *uuid in events)
+    {
+        ABCWallet *wallet = [self getWallet:uuid];
+        for (NSArray *event in [events objectForKey:uuid])
+        {
+            int type = [event[0] intValue];
+            NSString *txid = [event[1] length] ? event[1] : nil;
+            ABCTransaction *tx = nil;
+            if (txid)
+                tx = [wallet getTransaction:txid];
+            
+            if (ABC_AsyncEventType_IncomingBitCoin == type) {
+                if ([self.delegate respondsToSelector:@selector(abcAccountIncomingBitcoin:transaction:)]) {
+                    [self.delegate abcAccountIncomingBitcoin:wallet transaction:tx];
+                }
+            } else if (ABC_AsyncEventType_BalanceUpdate == type) {
+                if ([self.delegate respondsToSelector:@selector(abcAccountBalanceUpdate:transaction:)]) {
+                    [self.delegate abcAccountBalanceUpdate:wallet transaction:tx];
+                }
+            } else if (ABC_AsyncEventType_BlockHeightChange == type) {
+                if (wallet && [self.delegate respondsToSelector:@selector(abcAccountBlockHeightChanged:)]) {
+                    [self.delegate abcAccountBlockHeightChanged:wallet];
+                }
+            }
+        }
+    }
+}
+
 void ABC_BitCoin_Event_Callback(const tABC_AsyncBitCoinInfo *pInfo)
 {
     ABCAccount *account = (__bridge id) pInfo->pData;
@@ -1461,56 +2084,12 @@ void ABC_BitCoin_Event_Callback(const tABC_AsyncBitCoinInfo *pInfo)
         }
     }
     
-    if (ABC_AsyncEventType_IncomingBitCoin == pInfo->eventType) {
-        {
-            [account refreshWalletsIfNotBusy:^ {
-                if (account.delegate) {
-                    if ([account.delegate respondsToSelector:@selector(abcAccountIncomingBitcoin:transaction:)]) {
-                        ABCWallet *wallet = nil;
-                        ABCTransaction *tx = nil;
-                        if (walletUUID)
-                            wallet = [account getWallet:walletUUID];
-                        if (txid)
-                            tx = [wallet getTransaction:txid];
-                        [account.delegate abcAccountIncomingBitcoin:wallet transaction:tx];
-                    }
-                }
-            }];
-        }
-    } else if (ABC_AsyncEventType_BlockHeightChange == pInfo->eventType) {
-        ABCWallet *wallet = nil;
+    if (ABC_AsyncEventType_IncomingBitCoin == pInfo->eventType ||
+        ABC_AsyncEventType_BlockHeightChange == pInfo->eventType ||
+        ABC_AsyncEventType_TransactionUpdate == pInfo->eventType ||
+        ABC_AsyncEventType_BalanceUpdate == pInfo->eventType) {
         if (walletUUID)
-        {
-            wallet = [account getWallet:walletUUID];
-            if (wallet)
-            {
-                wallet.bBlockHeightChanged = YES;
-                if (account.delegate) {
-                    if ([account.delegate respondsToSelector:@selector(abcAccountBlockHeightChanged:)]) {
-                        dispatch_async(dispatch_get_main_queue(), ^(void) {
-                            [account.delegate abcAccountBlockHeightChanged:wallet];
-                        });
-                    }
-                }
-            }
-        }
-        
-    } else if (ABC_AsyncEventType_TransactionUpdate == pInfo->eventType) {
-        [account refreshWallets];
-    } else if (ABC_AsyncEventType_BalanceUpdate == pInfo->eventType) {
-        [account refreshWalletsIfNotBusy:^ {
-            if (account.delegate) {
-                if ([account.delegate respondsToSelector:@selector(abcAccountBalanceUpdate:transaction:)]) {
-                    ABCWallet *wallet = nil;
-                    ABCTransaction *tx = nil;
-                    if (walletUUID)
-                        wallet = [account getWallet:walletUUID];
-                    if (txid)
-                        tx = [wallet getTransaction:txid];
-                    [account.delegate abcAccountBalanceUpdate:wallet transaction:tx];
-                }
-            }
-        }];
+            [account queueWalletEvent:pInfo->eventType wallet:walletUUID txid:txid];
     } else if (ABC_AsyncEventType_IncomingSweep == pInfo->eventType) {
         ABCWallet *wallet = nil;
         ABCTransaction *tx = nil;
@@ -2213,3 +2792,12 @@ void ABC_BitCoin_Event_Callback(const tABC_AsyncBitCoinInfo *pInfo)
 }
 @end
 
+@implementation ABCDataSyncStats
+@end
+
+@implementation ABCTimelineFilter
+@end
+
+@implementation ABCWalletEvents
+@end
+
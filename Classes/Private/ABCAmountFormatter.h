@@ -0,0 +1,34 @@
+//
+// ABCAmountFormatter.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+//
+// Formats satoshi amounts with integer arithmetic into the current locale's decimal
+// style. The output matches what ABC_FormatAmount followed by an NSNumberFormatter
+// round trip produced. Rounding is half even, trailing fraction zeros are dropped,
+// and the locale's grouping, separators and digits are used.
+//
+// The locale settings are read once from an NSNumberFormatter and cached until the
+// current locale changes. Each call then fills one stack buffer and makes a single
+// NSString from it.
+//
+@interface ABCAmountFormatter : NSObject
+
+// Shared formatter for [NSLocale autoupdatingCurrentLocale]
++ (ABCAmountFormatter *)currentFormatter;
+
+- (id)initWithLocale:(NSLocale *)locale;
+
+// amount in satoshi. decimalPlaces is log10 of the denomination multiplier.
+// maxFractionDigits <= decimalPlaces. symbol, followed by a space, goes between the
+// sign and the number and may be nil.
+- (NSString *)stringFromSatoshi:(int64_t)amount
+                  decimalPlaces:(int)decimalPlaces
+              maxFractionDigits:(int)maxFractionDigits
+                         symbol:(NSString *)symbol;
+
+@end
@@ -0,0 +1,182 @@
+//
+// ABCAmountFormatter.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCAmountFormatter.h"
+
+#define MAX_SEPARATOR_LENGTH    8
+#define MAX_PREFIX_LENGTH       32
+#define MAX_FORMATTED_LENGTH    (MAX_PREFIX_LENGTH + 20 * (1 + MAX_SEPARATOR_LENGTH) + MAX_SEPARATOR_LENGTH + 20)
+
+static ABCAmountFormatter *currentFormatter = nil;
+
+static const uint64_t powersOf10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+    100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL
+};
+
+@interface ABCAmountFormatter ()
+{
+    unichar     _digits[10];
+    unichar     _decimal[MAX_SEPARATOR_LENGTH];
+    NSUInteger  _decimalLength;
+    unichar     _grouping[MAX_SEPARATOR_LENGTH];
+    NSUInteger  _groupingLength;
+    NSUInteger  _groupingSize;
+    NSUInteger  _secondaryGroupingSize;
+    NSUInteger  _minimumGroupingDigits;
+    BOOL        _bGrouping;
+}
+
+@end
+
+@implementation ABCAmountFormatter
+
++ (ABCAmountFormatter *)currentFormatter
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        [[NSNotificationCenter defaultCenter] addObserverForName:NSCurrentLocaleDidChangeNotification
+                                                          object:nil
+                                                           queue:nil
+                                                      usingBlock:^(NSNotification *note) {
+            @synchronized([ABCAmountFormatter class])
+            {
+                currentFormatter = nil;
+            }
+        }];
+    });
+    
+    @synchronized([ABCAmountFormatter class])
+    {
+        if (!currentFormatter)
+            currentFormatter = [[ABCAmountFormatter alloc] initWithLocale:[NSLocale autoupdatingCurrentLocale]];
+        return currentFormatter;
+    }
+}
+
+static NSUInteger copySeparator(NSString *s, unichar *dest)
+{
+    NSUInteger len = MIN([s length], (NSUInteger) MAX_SEPARATOR_LENGTH);
+    [s getCharacters:dest range:NSMakeRange(0, len)];
+    return len;
+}
+
+- (id)initWithLocale:(NSLocale *)locale
+{
+    self = [super init];
+    if (self)
+    {
+        NSNumberFormatter *f = [[NSNumberFormatter alloc] init];
+        [f setLocale:locale];
+        [f setNumberStyle:NSNumberFormatterDecimalStyle];
+        [f setMinimumFractionDigits:0];
+        
+        _decimalLength = copySeparator([f decimalSeparator], _decimal);
+        _groupingLength = copySeparator([f groupingSeparator], _grouping);
+        _bGrouping = [f usesGroupingSeparator] && _groupingLength > 0;
+        _groupingSize = [f groupingSize] ? [f groupingSize] : 3;
+        _secondaryGroupingSize = [f secondaryGroupingSize] ? [f secondaryGroupingSize] : _groupingSize;
+        
+        // Some locales only group once there are more than groupingSize + 1 digits.
+        // Find out by formatting the smallest number that could be grouped.
+        _minimumGroupingDigits = 1;
+        if (_bGrouping)
+        {
+            NSString *s = [f stringFromNumber:[NSNumber numberWithUnsignedLongLong:powersOf10[_groupingSize]]];
+            if ([s rangeOfString:[f groupingSeparator]].location == NSNotFound)
+                _minimumGroupingDigits = 2;
+        }
+        
+        // Digits may not be ASCII in every locale
+        for (int d = 0; d < 10; d++)
+        {
+            NSString *s = [f stringFromNumber:[NSNumber numberWithInt:d]];
+            _digits[d] = [s length] == 1 ? [s characterAtIndex:0] : (unichar) ('0' + d);
+        }
+    }
+    return self;
+}
+
+- (NSString *)stringFromSatoshi:(int64_t)amount
+                  decimalPlaces:(int)decimalPlaces
+              maxFractionDigits:(int)maxFractionDigits
+                         symbol:(NSString *)symbol
+{
+    unichar buf[MAX_FORMATTED_LENGTH];
+    NSUInteger len = 0;
+    
+    if (decimalPlaces < 0) decimalPlaces = 0;
+    if (decimalPlaces > 12) decimalPlaces = 12;
+    if (maxFractionDigits < 0) maxFractionDigits = 0;
+    if (maxFractionDigits > decimalPlaces) maxFractionDigits = decimalPlaces;
+    
+    BOOL negative = amount < 0;
+    uint64_t value = negative ? (uint64_t) 0 - (uint64_t) amount : (uint64_t) amount;
+    
+    // Round half even to maxFractionDigits
+    uint64_t drop = powersOf10[decimalPlaces - maxFractionDigits];
+    if (drop > 1)
+    {
+        uint64_t q = value / drop, r = value % drop, half = drop / 2;
+        if (r > half || (r == half && (q & 1)))
+            q++;
+        value = q;
+    }
+    uint64_t scale = powersOf10[maxFractionDigits];
+    uint64_t whole = value / scale;
+    uint64_t frac = value % scale;
+    
+    if (negative)
+        buf[len++] = '-';
+    if (symbol)
+    {
+        NSUInteger slen = MIN([symbol length], (NSUInteger) MAX_PREFIX_LENGTH - 1);
+        [symbol getCharacters:buf + len range:NSMakeRange(0, slen)];
+        len += slen;
+        buf[len++] = ' ';
+    }
+    
+    // Whole part, written backwards into a scratch buffer with grouping
+    unichar whole_buf[20 * (1 + MAX_SEPARATOR_LENGTH)];
+    NSUInteger wlen = 0, digits = 0;
+    NSUInteger totalDigits = 1;
+    for (uint64_t w = whole; w >= 10; w /= 10) totalDigits++;
+    BOOL bGroup = _bGrouping && totalDigits >= _groupingSize + _minimumGroupingDigits;
+    NSUInteger nextGroup = _groupingSize;
+    do
+    {
+        if (bGroup && digits == nextGroup)
+        {
+            for (NSUInteger i = _groupingLength; i > 0; i--)
+                whole_buf[wlen++] = _grouping[i - 1];
+            nextGroup += _secondaryGroupingSize;
+        }
+        whole_buf[wlen++] = _digits[whole % 10];
+        whole /= 10;
+        digits++;
+    } while (whole);
+    while (wlen)
+        buf[len++] = whole_buf[--wlen];
+    
+    // Fraction without trailing zeros
+    if (frac)
+    {
+        int fracDigits = maxFractionDigits;
+        while (frac % 10 == 0)
+        {
+            frac /= 10;
+            fracDigits--;
+        }
+        for (NSUInteger i = 0; i < _decimalLength; i++)
+            buf[len++] = _decimal[i];
+        for (int i = fracDigits - 1; i >= 0; i--)
+            buf[len++] = _digits[(frac / powersOf10[i]) % 10];
+    }
+    
+    return [NSString stringWithCharacters:buf length:len];
+}
+
+@end
@@ -0,0 +1,37 @@
+//
+// ABCBalanceHistory.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+//
+// Downsampled balance over time on a fixed grid of buckets that starts at 'start' and
+// is 'interval' seconds wide. Each bucket keeps its opening balance, its closing balance,
+// and the minimum and maximum balances reached inside it, so spikes survive the
+// downsampling.
+//
+// The history keeps a copy of the columns it was built from. On update, it finds the
+// oldest entry that differs and recomputes only the buckets from that one onward. New
+// transactions usually arrive at the newest end, so an update touches only the last
+// few buckets.
+//
+@interface ABCBalanceHistory : NSObject
+
+// interval widened, if needed, so that [start, end) fits in the maximum number of
+// buckets a history holds. Use the result for initWithStart:interval:.
++ (int64_t)intervalForStart:(int64_t)start end:(int64_t)end interval:(int64_t)interval;
+
+- (id)initWithStart:(int64_t)start interval:(int64_t)interval;
+
+// timestamps and balances are newest first. balances[i] is the balance after entry i.
+- (void)updateWithTimestamps:(const int64_t *)timestamps
+                    balances:(const int64_t *)balances
+                       count:(NSUInteger)count;
+
+// ABCBalancePoint objects from start up to end, oldest first. At most three points per
+// bucket, plus the opening and closing points.
+- (NSArray *)pointsTo:(int64_t)end;
+
+@end
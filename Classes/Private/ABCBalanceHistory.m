@@ -0,0 +1,216 @@
+//
+// ABCBalanceHistory.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCBalanceHistory.h"
+#import "ABCWallet.h"
+
+// Most buckets a history will hold. Wider ranges get a wider interval.
+static const int64_t maxBalanceBuckets = 10000;
+
+typedef struct
+{
+    int64_t     openBalance;
+    int64_t     minBalance;
+    int64_t     minTime;
+    int64_t     maxBalance;
+    int64_t     maxTime;
+    int64_t     closeBalance;
+    int64_t     closeTime;
+    uint32_t    count;
+} tBalanceBucket;
+
+@interface ABCBalanceHistory ()
+{
+    int64_t         _start;
+    int64_t         _interval;
+    NSMutableData   *_buckets;
+    NSData          *_timestamps;
+    NSData          *_balances;
+}
+
+@end
+
+@implementation ABCBalanceHistory
+
+- (id)initWithStart:(int64_t)start interval:(int64_t)interval
+{
+    self = [super init];
+    if (self)
+    {
+        _start = start;
+        _interval = interval > 0 ? interval : 1;
+        _buckets = [[NSMutableData alloc] init];
+        _timestamps = [[NSData alloc] init];
+        _balances = [[NSData alloc] init];
+    }
+    return self;
+}
+
++ (int64_t)intervalForStart:(int64_t)start end:(int64_t)end interval:(int64_t)interval
+{
+    if (interval < 1)
+        interval = 1;
+    if (end > start && (end - start) / interval >= maxBalanceBuckets)
+        interval = (end - start) / maxBalanceBuckets + 1;
+    return interval;
+}
+
+// Entries past the last bucket, ie. stamped in the future, are kept in the last one
+- (NSUInteger)bucketForTime:(int64_t)t
+{
+    if (t < _start)
+        return 0;
+    int64_t b = (t - _start) / _interval;
+    return (NSUInteger) (b < maxBalanceBuckets ? b : maxBalanceBuckets - 1);
+}
+
+// Index of the newest entry with timestamp < t, or count if there is none
+static NSUInteger indexBefore(const int64_t *ts, NSUInteger count, int64_t t)
+{
+    NSUInteger lo = 0, hi = count;
+    while (lo < hi)
+    {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if (ts[mid] >= t)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+- (void)updateWithTimestamps:(const int64_t *)ts
+                    balances:(const int64_t *)bal
+                       count:(NSUInteger)count
+{
+    @synchronized(self)
+    {
+        // Find how many of the oldest entries are unchanged
+        const int64_t *oldTs = [_timestamps bytes];
+        const int64_t *oldBal = [_balances bytes];
+        NSUInteger oldCount = [_timestamps length] / sizeof(int64_t);
+        NSUInteger same = 0;
+        while (same < oldCount && same < count &&
+               oldTs[oldCount - 1 - same] == ts[count - 1 - same] &&
+               oldBal[oldCount - 1 - same] == bal[count - 1 - same])
+            same++;
+        if (same == oldCount && same == count && [_buckets length])
+            return;
+        
+        int64_t changed;
+        if (same < count && same < oldCount)
+            changed = MIN(ts[count - 1 - same], oldTs[oldCount - 1 - same]);
+        else if (same < count)
+            changed = ts[count - 1 - same];
+        else if (same < oldCount)
+            changed = oldTs[oldCount - 1 - same];
+        else
+            changed = _start;
+        
+        // Drop the buckets from the first changed one onward and rebuild them
+        NSUInteger first = [self bucketForTime:changed];
+        NSUInteger kept = MIN(first, [_buckets length] / sizeof(tBalanceBucket));
+        [_buckets setLength:kept * sizeof(tBalanceBucket)];
+        
+        int64_t bucketStart = _start + (int64_t) kept * _interval;
+        NSUInteger i = indexBefore(ts, count, bucketStart);
+        int64_t balance = i < count ? bal[i] : 0;
+        tBalanceBucket bucket;
+        memset(&bucket, 0, sizeof(bucket));
+        NSUInteger current = kept;
+        bucket.openBalance = bucket.minBalance = bucket.maxBalance = balance;
+        
+        // Walk the remaining entries oldest to newest
+        while (i-- > 0)
+        {
+            NSUInteger b = [self bucketForTime:ts[i]];
+            while (current < b)
+            {
+                [_buckets appendBytes:&bucket length:sizeof(bucket)];
+                memset(&bucket, 0, sizeof(bucket));
+                bucket.openBalance = bucket.minBalance = bucket.maxBalance = balance;
+                current++;
+            }
+            balance = bal[i];
+            if (bucket.count == 0 || balance < bucket.minBalance)
+            {
+                bucket.minBalance = balance;
+                bucket.minTime = ts[i];
+            }
+            if (bucket.count == 0 || balance > bucket.maxBalance)
+            {
+                bucket.maxBalance = balance;
+                bucket.maxTime = ts[i];
+            }
+            bucket.closeBalance = balance;
+            bucket.closeTime = ts[i];
+            bucket.count++;
+        }
+        [_buckets appendBytes:&bucket length:sizeof(bucket)];
+        
+        _timestamps = [NSData dataWithBytes:ts length:count * sizeof(int64_t)];
+        _balances = [NSData dataWithBytes:bal length:count * sizeof(int64_t)];
+    }
+}
+
+static void addPoint(NSMutableArray *points, int64_t t, int64_t balance)
+{
+    ABCBalancePoint *last = [points lastObject];
+    if (last && last.balance == balance && (int64_t) [last.date timeIntervalSince1970] == t)
+        return;
+    ABCBalancePoint *point = [[ABCBalancePoint alloc] init];
+    point.date = [NSDate dateWithTimeIntervalSince1970:t];
+    point.balance = balance;
+    [points addObject:point];
+}
+
+- (NSArray *)pointsTo:(int64_t)end
+{
+    NSMutableArray *points = [[NSMutableArray alloc] init];
+    @synchronized(self)
+    {
+        const tBalanceBucket *buckets = [_buckets bytes];
+        NSUInteger count = [_buckets length] / sizeof(tBalanceBucket);
+        if (!count || end <= _start)
+            return points;
+        
+        NSUInteger last = [self bucketForTime:end - 1];
+        addPoint(points, _start, buckets[0].openBalance);
+        for (NSUInteger b = 0; b < count && b <= last; b++)
+        {
+            const tBalanceBucket *bucket = &buckets[b];
+            if (!bucket->count)
+                continue;
+            
+            // Emit the low, the high and the closing balance of the bucket in time order
+            int64_t times[3] = { bucket->minTime, bucket->maxTime, bucket->closeTime };
+            int64_t values[3] = { bucket->minBalance, bucket->maxBalance, bucket->closeBalance };
+            for (int j = 1; j < 3; j++)
+            {
+                for (int k = j; k > 0 && times[k] < times[k - 1]; k--)
+                {
+                    int64_t t = times[k]; times[k] = times[k - 1]; times[k - 1] = t;
+                    int64_t v = values[k]; values[k] = values[k - 1]; values[k - 1] = v;
+                }
+            }
+            for (int j = 0; j < 3; j++)
+            {
+                if (times[j] < end)
+                    addPoint(points, times[j], values[j]);
+            }
+        }
+        
+        // Closing point at end with the balance as of end
+        const int64_t *ts = [_timestamps bytes];
+        const int64_t *bal = [_balances bytes];
+        NSUInteger n = [_timestamps length] / sizeof(int64_t);
+        NSUInteger i = indexBefore(ts, n, end);
+        addPoint(points, end, i < n ? bal[i] : 0);
+    }
+    return points;
+}
+
+@end
@@ -32,6 +32,7 @@
 @property (atomic, strong) NSMutableArray           *loggedInUsers;
 @property (atomic, strong) ABCExchangeCache         *exchangeCache;
 @property (atomic, strong) NSOperationQueue         *exchangeQueue;
+@property (atomic, copy)   NSString                 *rootDirectory;
 
 - (NSDate *)dateFromTimestamp:(int64_t) intDate;
 - (ABCError *)setupOTPKey:(NSString *)username
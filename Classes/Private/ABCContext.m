@@ -1,5 +1,6 @@
 
 #import "ABCContext+Internal.h"
+#import "ABCScheduler.h"
 #import <pthread.h>
 
 #define ABC_VERSION_STRING @"0.9.1"
@@ -39,6 +40,7 @@
 @property (atomic, strong) ABCKeychain              *keyChain;
 @property (atomic, strong) NSMutableArray           *loggedInUsers;
 @property (atomic, strong) NSOperationQueue         *exchangeQueue;
+@property (atomic, copy)   NSString                 *rootDirectory;
 
 @end
 
@@ -84,6 +86,7 @@
             if(![fileManager createDirectoryAtPath:docs_dir withIntermediateDirectories:YES attributes:nil error:NULL])
                 ABCLog(@"Error: Create folder failed %@", docs_dir);
 #endif
+        abcContext.rootDirectory = docs_dir;
         Error.code = ABC_CC_Ok;
         ABC_Initialize([docs_dir UTF8String],
                 [ca_path UTF8String],
@@ -116,12 +119,9 @@
     {
         if (self.exchangeQueue)
             [self.exchangeQueue cancelAllOperations];
-        int wait = 0;
-        int maxWait = 200; // ~10 seconds
-        while ([self.exchangeQueue operationCount] > 0 && wait < maxWait) {
-            [NSThread sleepForTimeInterval:.2];
-            wait++;
-        }
+        // Wait up to ~10 seconds for an in-flight exchange rate update
+        if (![ABCScheduler waitForQueue:self.exchangeQueue timeout:10])
+            ABCLog(0, @"free: timed out waiting for exchange queue");
         self.exchangeQueue = nil;
 
         for (ABCAccount *user in self.loggedInUsers)
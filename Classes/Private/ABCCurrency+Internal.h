@@ -12,4 +12,8 @@
 
 + (NSArray *) listCurrencyNums;
 
+// Hashed lookups built alongside the currency arrays. nil if the currency is unknown.
++ (ABCCurrency *) currencyForCode:(NSString *)code;
++ (ABCCurrency *) currencyForNum:(int)num;
+
 @end
@@ -19,6 +19,8 @@ static NSArray                  *arrayCurrency = nil;
 static NSArray                  *arrayCurrencyNums = nil;
 static NSArray                  *arrayCurrencyCodes = nil;
 static NSArray                  *arrayCurrencyStrings = nil;
+static NSDictionary             *dictCurrencyByCode = nil;
+static NSArray                  *arrayCurrencyByNum = nil;  // indexed by currencyNum, NSNull for gaps
 static NSNumberFormatter        *numberFormatter = nil;
 
 @implementation ABCCurrency
@@ -78,6 +80,26 @@ static NSNumberFormatter        *numberFormatter = nil;
     return arrayCurrencyNums;
 }
 
++ (ABCCurrency *) currencyForCode:(NSString *)code;
+{
+    if (!dictCurrencyByCode)
+        [ABCCurrency initializeCurrencyArrays];
+    if (!code)
+        return nil;
+    return [dictCurrencyByCode objectForKey:code];
+}
+
++ (ABCCurrency *) currencyForNum:(int)num;
+{
+    if (!arrayCurrencyByNum)
+        [ABCCurrency initializeCurrencyArrays];
+    NSArray *byNum = arrayCurrencyByNum;
+    if (num < 0 || num >= [byNum count])
+        return nil;
+    id currency = byNum[num];
+    return currency == [NSNull null] ? nil : currency;
+}
+
 - (NSString *)symbol
 {
     if (!_symbol)
@@ -124,6 +146,8 @@ const NSString *syncToken = @"ABCCurrencySyncToken";
         NSMutableArray *lArrayCurrencyNums = [[NSMutableArray alloc] initWithCapacity:currencyCount];
         NSMutableArray *lArrayCurrencyCodes = [[NSMutableArray alloc] initWithCapacity:currencyCount];
         NSMutableArray *lArrayCurrencyStrings = [[NSMutableArray alloc] initWithCapacity:currencyCount];
+        NSMutableDictionary *lDictCurrencyByCode = [[NSMutableDictionary alloc] initWithCapacity:currencyCount];
+        NSMutableArray *lArrayCurrencyByNum = [[NSMutableArray alloc] init];
         
         for (int i = 0; i < currencyCount; i++)
         {
@@ -139,11 +163,22 @@ const NSString *syncToken = @"ABCCurrencySyncToken";
             [lArrayCurrencyCodes addObject:currency.code];
             [lArrayCurrencyNums addObject:[NSNumber numberWithInt:aCurrencies[i].num]];
             [lArrayCurrencyStrings addObject:currency.textDescription];
+            
+            // ISO 4217 numbers are below 1000 so a dense array indexed by number is small
+            [lDictCurrencyByCode setObject:currency forKey:currency.code];
+            if (currency.currencyNum >= 0 && currency.currencyNum < 1000)
+            {
+                while ([lArrayCurrencyByNum count] <= currency.currencyNum)
+                    [lArrayCurrencyByNum addObject:[NSNull null]];
+                lArrayCurrencyByNum[currency.currencyNum] = currency;
+            }
         }
         arrayCurrency          = lArrayCurrency;
         arrayCurrencyNums      = lArrayCurrencyNums;
         arrayCurrencyStrings   = lArrayCurrencyStrings;
         arrayCurrencyCodes     = lArrayCurrencyCodes;
+        dictCurrencyByCode     = lDictCurrencyByCode;
+        arrayCurrencyByNum     = lArrayCurrencyByNum;
     }
 }
 
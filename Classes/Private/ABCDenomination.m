@@ -5,6 +5,7 @@
 
 #import "ABCDenomination.h"
 #import "ABCContext+Internal.h"
+#import "ABCAmountFormatter.h"
 
 @interface ABCDenomination ()
 
@@ -137,8 +138,6 @@ static NSLocale *usLocale = nil;
                       withSymbol:(bool)symbol
                     cropDecimals:(BOOL)cropDecimals
 {
-    tABC_Error error;
-    char *pFormatted = NULL;
     int decimalPlaces, prettyDecimalPlaces;
     
     decimalPlaces = [self maxBitcoinDecimalPlaces];
@@ -151,44 +150,13 @@ static NSLocale *usLocale = nil;
     {
         prettyDecimalPlaces = decimalPlaces;
     }
-
     
-    bool negative = amount < 0;
-    amount = llabs(amount);
-    if (ABC_FormatAmount(amount, &pFormatted, decimalPlaces, false, &error) != ABC_CC_Ok)
-    {
-        return nil;
-    }
-    else
-    {
-        NSMutableString *formatted = [[NSMutableString alloc] init];
-        if (negative)
-            [formatted appendString: @"-"];
-        if (symbol && self.symbol)
-        {
-            [formatted appendString: self.symbol];
-            [formatted appendString: @" "];
-        }
-
-        NSNumberFormatter *f = [ABCDenomination generateNumberFormatter];
-        [f setMinimumFractionDigits:0];
-        [f setMaximumFractionDigits:prettyDecimalPlaces];
-
-        // Use NSNumberFormatter in US locale to convert ABC formatted string
-        // to NSNumber
-        [f setLocale:usLocale];
-        NSString *str1 = [NSString stringWithUTF8String:pFormatted];
-        NSNumber *nsnum = [f numberFromString:str1];
-
-        // Use NSNumberFormatter to output an NSString in localized number format
-        [f setLocale:locale];
-        NSString *str2 = [f stringFromNumber:nsnum];
-        if (str2)
-            [formatted appendString:str2];
-
-        free(pFormatted);
-        return formatted;
-    }
+    // Same output as ABC_FormatAmount parsed and re-formatted through NSNumberFormatter
+    // in the user's locale, without the C string and the formatter round trip
+    return [[ABCAmountFormatter currentFormatter] stringFromSatoshi:amount
+                                                      decimalPlaces:decimalPlaces
+                                                  maxFractionDigits:prettyDecimalPlaces
+                                                             symbol:symbol ? self.symbol : nil];
 }
 
 + (NSString *) getDecimalSymbol;
@@ -6,16 +6,52 @@
 //
 
 #import "ABCExchangeCache+Internal.h"
+#import "ABCRateHistory.h"
+
+#define SATOSHI_PER_BTC     100000000.0
+#define MAX_CURRENCY_NUM    1000            // ISO 4217 currency numbers are below this
+
+// Rates fetched more recently than this are not fetched again unless a per currency
+// TTL says otherwise. Half the refresh timer interval so every tick still refreshes.
+static const NSTimeInterval defaultRateTTLSeconds = ABC_EXCHANGE_RATE_REFRESH_INTERVAL_SECONDS / 2;
+
+// Number of currencies fetched from the exchange servers at the same time
+static const int rateFetchConcurrency = 3;
+
+//
+// Immutable table of BTC exchange rates indexed by currency number. Readers take the
+// current snapshot from ABCExchangeCache.rates and do plain arithmetic on it. Writers
+// copy the table, change the copy and swap it in.
+//
+@interface ABCRateSnapshot : NSObject
+{
+@public
+    double          rates[MAX_CURRENCY_NUM];      // fiat per BTC, 0 if unknown
+    NSTimeInterval  timestamps[MAX_CURRENCY_NUM]; // when each rate was read from the core
+    CFAbsoluteTime  expires[MAX_CURRENCY_NUM];    // when each rate passes its TTL
+}
+@end
+
+@implementation ABCRateSnapshot
+@end
+
+@implementation ABCExchangeRateStats
+@end
 
 @interface ABCExchangeCache ()
 {
 //    ABCError                                        *abcError;
-    
+    NSTimeInterval  staleRefreshRequested[MAX_CURRENCY_NUM];    // only touched on exchangeQueue
 }
 
 @property (atomic, strong)      ABCContext *abc;
 @property (atomic, strong)      ABCAccount              *account;
-@property (atomic, strong)      NSMutableArray          *currenciesToCheck;
+@property (atomic, strong)      NSMutableIndexSet       *currencyNumsToCheck;  // only touched on exchangeQueue
+@property (atomic, strong)      NSMutableDictionary     *rateTTLs;
+@property (atomic, strong)      ABCRateSnapshot         *rates;
+@property (nonatomic, strong)   ABCRateHistory          *rateHistory;
+@property (atomic)              BOOL                    bUpdateInFlight;
+@property (atomic)              BOOL                    bUpdatePending;
 
 @end
 
@@ -26,57 +62,51 @@
     // get the currencies
     self.abc = abc;
     
-    self.currenciesToCheck = [[NSMutableArray alloc] init];
+    self.currencyNumsToCheck = [[NSMutableIndexSet alloc] init];
+    self.rateTTLs = [[NSMutableDictionary alloc] init];
+    self.rates = [[ABCRateSnapshot alloc] init];
     
     return self;
 }
 
 - (int) getCurrencyNumFromCode:(NSString *)code;
 {
-    int index = (int) [[ABCCurrency listCurrencyCodes] indexOfObject:code];
-    if (index < 0)
-        return [ABCCurrency noCurrency].currencyNum;
-    if (index >= [[ABCCurrency listCurrencyNums] count])
+    ABCCurrency *currency = [ABCCurrency currencyForCode:code];
+    if (!currency)
         return [ABCCurrency noCurrency].currencyNum;
-    
-    NSNumber *currencyNum = [ABCCurrency listCurrencyNums][index];
-    
-    return (int)[currencyNum integerValue];
+    return currency.currencyNum;
 }
 
 - (ABCCurrency *) getCurrencyFromCode:(NSString *)code;
 {
-    int index = (int) [[ABCCurrency listCurrencyCodes] indexOfObject:code];
-    if (index < 0)
+    ABCCurrency *currency = [ABCCurrency currencyForCode:code];
+    if (!currency)
         return [ABCCurrency noCurrency];
-    if (index >= [[ABCCurrency listCurrencies] count])
-        return [ABCCurrency noCurrency];
-    
-    return [ABCCurrency listCurrencies][index];
+    return currency;
 }
 
 - (NSString *) getCurrencyCodeFromNum:(int) num;
 {
-    int index = (int) [[ABCCurrency listCurrencyNums] indexOfObject:[NSNumber numberWithInt:num]];
-    if (index < 0)
-        return [ABCCurrency noCurrency].code;
-    if (index >= [[ABCCurrency listCurrencyCodes] count])
+    ABCCurrency *currency = [ABCCurrency currencyForNum:num];
+    if (!currency)
         return [ABCCurrency noCurrency].code;
-    
-    return [ABCCurrency listCurrencyCodes][index];
+    return currency.code;
 }
 
 - (ABCCurrency *) getCurrencyFromNum:(int) num;
 {
-    int index = (int) [[ABCCurrency listCurrencyNums] indexOfObject:[NSNumber numberWithInt:num]];
-    if (index < 0)
+    ABCCurrency *currency = [ABCCurrency currencyForNum:num];
+    if (!currency)
         return [ABCCurrency noCurrency];
-    if (index >= [[ABCCurrency listCurrencies] count])
-        return [ABCCurrency noCurrency];
-    
-    return [ABCCurrency listCurrencies][index];
+    return currency;
 }
 
+//
+// Conversions use the rate snapshot when it has the currency. A snapshot rate past its
+// TTL is still used, since the core would return the same rate, but a refresh is
+// queued. When the snapshot does not have the currency, the core converts and the
+// snapshot picks the rate up in the background.
+//
 - (double) satoshiToCurrency:(uint64_t) satoshi
                 currencyCode:(NSString *)currencyCode
                        error:(ABCError **)nserror;
@@ -87,21 +117,20 @@
     
     int currencyNum = [self getCurrencyNumFromCode:currencyCode];
     
+    double rate = [self rateForCurrencyNum:currencyNum];
+    if (rate > 0)
+    {
+        if (nserror) *nserror = nil;
+        return ((double) satoshi / SATOSHI_PER_BTC) * rate;
+    }
+    
     ABC_SatoshiToCurrency(nil, nil,
                           satoshi, &currency, currencyNum, &error);
     nserror2 = [ABCError makeNSError:error];
-    if (nserror2)
-    {
-        ABCCurrency *c = [self getCurrencyFromCode:currencyCode];
-        [self addCurrencyToCheck:c];
-        
-        if (self.abc.loggedInUsers && [self.abc.loggedInUsers count])
-        {
-            ABCAccount *account = self.abc.loggedInUsers[0];
-            if (account)
-                [account requestExchangeRateUpdate];
-        }
-    }
+    if (!nserror2)
+        [self updateRateForCurrencyNum:currencyNum];
+    else
+        [self requestRateUpdateForCurrencyCode:currencyCode];
     
     if (nserror) *nserror = nserror2;
     
@@ -115,67 +144,344 @@
     tABC_Error error;
     ABCError *nserror2 = nil;
     int64_t satoshi = 0;
-    
+
+    // Satoshi amounts are unsigned, and a negative double cast to uint64_t is undefined
+    if (currency <= 0)
+    {
+        if (nserror) *nserror = nil;
+        return 0;
+    }
+
     int currencyNum = [self getCurrencyNumFromCode:currencyCode];
     
+    double rate = [self rateForCurrencyNum:currencyNum];
+    if (rate > 0)
+    {
+        if (nserror) *nserror = nil;
+        return (uint64_t) ((currency / rate) * SATOSHI_PER_BTC);
+    }
+    
     ABC_CurrencyToSatoshi(nil, nil, currency, currencyNum, &satoshi, &error);
     nserror2 = [ABCError makeNSError:error];
-    if (nserror2)
+    if (!nserror2)
+        [self updateRateForCurrencyNum:currencyNum];
+    else
+        [self requestRateUpdateForCurrencyCode:currencyCode];
+
+    if (nserror) *nserror = nserror2;
+    
+    return (uint64_t) satoshi;
+}
+
+// The core has this rate but our snapshot does not yet
+- (void)updateRateForCurrencyNum:(int)currencyNum
+{
+    [self.abc.exchangeQueue addOperationWithBlock:^{
+        [self updateRatesForCurrencyNums:@[[NSNumber numberWithInt:currencyNum]] fetched:NO];
+    }];
+}
+
+// Adds the currency to the ones refreshed from the exchange servers and starts a refresh
+- (void)requestRateUpdateForCurrencyCode:(NSString *)currencyCode
+{
+    ABCCurrency *c = [self getCurrencyFromCode:currencyCode];
+    [self addCurrencyToCheck:c];
+    
+    NSArray *users = self.abc.loggedInUsers;
+    if ([users count])
     {
-        ABCCurrency *c = [self getCurrencyFromCode:currencyCode];
-        [self addCurrencyToCheck:c];
-        
-        ABCAccount *account = self.abc.loggedInUsers[0];
+        ABCAccount *account = users[0];
         if (account)
             [account requestExchangeRateUpdate];
     }
+}
 
-    if (nserror) *nserror = nserror2;
-    
-    return (uint64_t) satoshi;
+#pragma mark - Rate snapshot
+
+//
+// The conversion read path. No locks and no allocation: the TTL is already folded into
+// the snapshot's expiry times when the snapshot is swapped in.
+//
+- (double)rateForCurrencyNum:(int)currencyNum
+{
+    if (currencyNum <= 0 || currencyNum >= MAX_CURRENCY_NUM)
+        return 0;
+    ABCRateSnapshot *snapshot = self.rates;
+    double rate = snapshot->rates[currencyNum];
+    if (rate > 0 && CFAbsoluteTimeGetCurrent() >= snapshot->expires[currencyNum])
+        [self rateExpiredForCurrencyNum:currencyNum];
+    return rate;
 }
 
-- (void)addCurrencyToCheck:(ABCCurrency *)currency;
+//
+// Requests a refresh of a rate read past its TTL and pushes its expiry out by another
+// TTL, so reads stop asking and a failing exchange server is not asked again on every
+// conversion.
+//
+- (void)rateExpiredForCurrencyNum:(int)currencyNum
 {
     [self.abc.exchangeQueue addOperationWithBlock:^{
-        if ([self.currenciesToCheck indexOfObject:currency] == NSNotFound)
+        ABCRateSnapshot *old = self.rates;
+        if (CFAbsoluteTimeGetCurrent() < old->expires[currencyNum])
+            return;
+        NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+        NSTimeInterval ttl = [self rateTTLForCurrencyNum:currencyNum];
+        if (now - staleRefreshRequested[currencyNum] >= ttl)
         {
-            [self.currenciesToCheck addObject:currency];
+            staleRefreshRequested[currencyNum] = now;
+            [self requestRateUpdateForCurrencyCode:[self getCurrencyCodeFromNum:currencyNum]];
         }
+        
+        ABCRateSnapshot *snapshot = [self copyRates:old];
+        snapshot->expires[currencyNum] = CFAbsoluteTimeGetCurrent() + ttl;
+        self.rates = snapshot;
     }];
 }
 
-- (void)addCurrenciesToCheck:(NSMutableArray *)currencies;
+- (ABCRateSnapshot *)copyRates:(ABCRateSnapshot *)old
 {
-    [self.abc.exchangeQueue addOperationWithBlock:^{
-        for (ABCCurrency *c in currencies)
+    ABCRateSnapshot *snapshot = [[ABCRateSnapshot alloc] init];
+    memcpy(snapshot->rates, old->rates, sizeof(snapshot->rates));
+    memcpy(snapshot->timestamps, old->timestamps, sizeof(snapshot->timestamps));
+    memcpy(snapshot->expires, old->expires, sizeof(snapshot->expires));
+    return snapshot;
+}
+
+- (void)setExpiryForCurrencyNum:(int)num snapshot:(ABCRateSnapshot *)snapshot
+{
+    snapshot->expires[num] = snapshot->timestamps[num] - kCFAbsoluteTimeIntervalSince1970
+                             + [self rateTTLForCurrencyNum:num];
+}
+
+//
+// Reads the current rate of each currency from the core and swaps in a new snapshot.
+// Called on exchangeQueue. bFetched is YES when the core's rates were just fetched
+// from the exchange servers, which restarts their TTL.
+//
+- (void)updateRatesForCurrencyNums:(NSArray *)currencyNums fetched:(BOOL)bFetched
+{
+    ABCRateSnapshot *snapshot = [self copyRates:self.rates];
+    
+    NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+    for (NSNumber *n in currencyNums)
+    {
+        int num = [n intValue];
+        if (num <= 0 || num >= MAX_CURRENCY_NUM)
+            continue;
+        tABC_Error error;
+        double rate = 0.0;
+        ABC_SatoshiToCurrency(nil, nil, (int64_t) SATOSHI_PER_BTC, &rate, num, &error);
+        if (ABC_CC_Ok == error.code && rate > 0)
         {
-            if ([self.currenciesToCheck indexOfObject:c] == NSNotFound)
+            snapshot->rates[num] = rate;
+            if (bFetched)
             {
-                [self.currenciesToCheck addObject:c];
+                snapshot->timestamps[num] = now;
+                [self setExpiryForCurrencyNum:num snapshot:snapshot];
             }
         }
-    }];
+    }
+    self.rates = snapshot;
 }
 
-- (void)updateExchangeCache;
+- (void)setRateTTL:(NSTimeInterval)ttl forCurrencyCode:(NSString *)currencyCode;
 {
-    tABC_Error error;
+    int num = [self getCurrencyNumFromCode:currencyCode];
+    @synchronized(self.rateTTLs)
+    {
+        if (ttl > 0)
+            [self.rateTTLs setObject:[NSNumber numberWithDouble:ttl] forKey:[NSNumber numberWithInt:num]];
+        else
+            [self.rateTTLs removeObjectForKey:[NSNumber numberWithInt:num]];
+    }
     
+    if (num <= 0 || num >= MAX_CURRENCY_NUM)
+        return;
     [self.abc.exchangeQueue addOperationWithBlock:^{
-        for (ABCCurrency *c in self.currenciesToCheck)
+        ABCRateSnapshot *snapshot = [self copyRates:self.rates];
+        [self setExpiryForCurrencyNum:num snapshot:snapshot];
+        self.rates = snapshot;
+    }];
+}
+
+- (NSTimeInterval)rateTTLForCurrencyNum:(int)num
+{
+    @synchronized(self.rateTTLs)
+    {
+        NSNumber *ttl = [self.rateTTLs objectForKey:[NSNumber numberWithInt:num]];
+        return ttl ? [ttl doubleValue] : defaultRateTTLSeconds;
+    }
+}
+
+#pragma mark - Rate history
+
+- (ABCRateHistory *)history
+{
+    @synchronized(self)
+    {
+        if (!self.rateHistory && self.abc.rootDirectory)
         {
-            // We pass no callback so this call is blocking
-            ABC_RequestExchangeRateUpdate(nil,
-                                          nil,
-                                          c.currencyNum, &error);
-            
+            NSString *dir = [self.abc.rootDirectory stringByAppendingPathComponent:@"Rates"];
+            self.rateHistory = [[ABCRateHistory alloc] initWithDirectory:dir];
         }
-        [[NSThread currentThread] setName:@"Exchange Rate Update"];
+        return self.rateHistory;
+    }
+}
+
+// Called on exchangeQueue after the snapshot has been updated with freshly fetched rates
+- (void)recordRateHistoryForCurrencyNums:(NSArray *)currencyNums
+{
+    ABCRateHistory *history = [self history];
+    ABCRateSnapshot *snapshot = self.rates;
+    for (NSNumber *n in currencyNums)
+    {
+        int num = [n intValue];
+        if (num <= 0 || num >= MAX_CURRENCY_NUM)
+            continue;
+        [history addRate:snapshot->rates[num]
+               timestamp:(int64_t) snapshot->timestamps[num]
+             currencyNum:num];
+    }
+}
+
+- (double)rateAtDate:(NSDate *)date currencyCode:(NSString *)currencyCode;
+{
+    int num = [self getCurrencyNumFromCode:currencyCode];
+    return [[self history] rateAtTimestamp:(int64_t) [date timeIntervalSince1970] currencyNum:num];
+}
+
+- (NSArray *)historicalCurrencyValuesForTransactions:(NSArray *)transactions
+                                        currencyCode:(NSString *)currencyCode;
+{
+    NSUInteger count = [transactions count];
+    int num = [self getCurrencyNumFromCode:currencyCode];
+    int64_t *timestamps = calloc(count ? count : 1, sizeof(int64_t));
+    double *rates = calloc(count ? count : 1, sizeof(double));
+    for (NSUInteger i = 0; i < count; i++)
+        timestamps[i] = (int64_t) [((ABCTransaction *) transactions[i]).date timeIntervalSince1970];
+    
+    [[self history] ratesAtTimestamps:timestamps count:count currencyNum:num rates:rates];
+    
+    NSMutableArray *values = [[NSMutableArray alloc] initWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++)
+    {
+        ABCTransaction *t = transactions[i];
+        [values addObject:[NSNumber numberWithDouble:((double) t.amountSatoshi / SATOSHI_PER_BTC) * rates[i]]];
+    }
+    free(timestamps);
+    free(rates);
+    return values;
+}
+
+- (void)addCurrencyToCheck:(ABCCurrency *)currency;
+{
+    int num = currency.currencyNum;
+    [self.abc.exchangeQueue addOperationWithBlock:^{
+        if (num > 0)
+            [self.currencyNumsToCheck addIndex:num];
     }];
 }
 
+- (void)addCurrenciesToCheck:(NSMutableArray *)currencies;
+{
+    NSMutableIndexSet *nums = [[NSMutableIndexSet alloc] init];
+    for (ABCCurrency *c in currencies)
+    {
+        if (c.currencyNum > 0)
+            [nums addIndex:c.currencyNum];
+    }
+    [self.abc.exchangeQueue addOperationWithBlock:^{
+        [self.currencyNumsToCheck addIndexes:nums];
+    }];
+}
 
+//
+// Fetches every currency in currencyNumsToCheck whose rate is older than its TTL.
+// The fetches run a few at a time. If an update is already running, this call only
+// marks that another pass is wanted, and that pass runs when the current one finishes.
+//
+- (void)updateExchangeCache;
+{
+    @synchronized(self)
+    {
+        if (self.bUpdateInFlight)
+        {
+            self.bUpdatePending = YES;
+            return;
+        }
+        self.bUpdateInFlight = YES;
+        self.bUpdatePending = NO;
+    }
+    
+    [self.abc.exchangeQueue addOperationWithBlock:^{
+        [[NSThread currentThread] setName:@"Exchange Rate Update"];
+        CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+        ABCExchangeRateStats *stats = [[ABCExchangeRateStats alloc] init];
+        
+        // Pick the currencies that are due
+        ABCRateSnapshot *snapshot = self.rates;
+        NSTimeInterval now = [[NSDate date] timeIntervalSince1970];
+        NSMutableArray *due = [[NSMutableArray alloc] init];
+        [self.currencyNumsToCheck enumerateIndexesUsingBlock:^(NSUInteger num, BOOL *stop) {
+            if (num < MAX_CURRENCY_NUM && snapshot->rates[num] > 0 &&
+                now - snapshot->timestamps[num] < [self rateTTLForCurrencyNum:(int) num])
+            {
+                stats.currenciesFresh++;
+                return;
+            }
+            [due addObject:[NSNumber numberWithUnsignedInteger:num]];
+        }];
+        
+        // Fetch them a few at a time. Each ABC_RequestExchangeRateUpdate blocks.
+        NSMutableArray *fetched = [[NSMutableArray alloc] init];
+        __block double slowest = 0;
+        __block int failed = 0;
+        dispatch_group_t group = dispatch_group_create();
+        dispatch_semaphore_t slots = dispatch_semaphore_create(rateFetchConcurrency);
+        dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_LOW, 0);
+        for (NSNumber *n in due)
+        {
+            dispatch_semaphore_wait(slots, DISPATCH_TIME_FOREVER);
+            dispatch_group_async(group, queue, ^{
+                tABC_Error error;
+                CFAbsoluteTime fetchStart = CFAbsoluteTimeGetCurrent();
+                // We pass no callback so this call is blocking
+                ABC_RequestExchangeRateUpdate(nil, nil, [n intValue], &error);
+                double elapsed = CFAbsoluteTimeGetCurrent() - fetchStart;
+                @synchronized(fetched)
+                {
+                    if (ABC_CC_Ok == error.code)
+                        [fetched addObject:n];
+                    else
+                        failed++;
+                    if (elapsed > slowest)
+                        slowest = elapsed;
+                }
+                dispatch_semaphore_signal(slots);
+            });
+        }
+        dispatch_group_wait(group, DISPATCH_TIME_FOREVER);
+        [self updateRatesForCurrencyNums:fetched fetched:YES];
+        [self recordRateHistoryForCurrencyNums:fetched];
+        
+        stats.currenciesRequested = (int) [due count];
+        stats.currenciesFailed = failed;
+        stats.slowestFetchTime = slowest;
+        stats.wallTime = CFAbsoluteTimeGetCurrent() - start;
+        self.lastUpdateStats = stats;
+        ABCLog(2, @"Exchange rate update: %d fetched %d fresh %d failed in %.2fs",
+               stats.currenciesRequested, stats.currenciesFresh, stats.currenciesFailed, stats.wallTime);
+        
+        BOOL bAgain;
+        @synchronized(self)
+        {
+            self.bUpdateInFlight = NO;
+            bAgain = self.bUpdatePending;
+        }
+        if (bAgain)
+            [self updateExchangeCache];
+    }];
+}
 
 @end
 
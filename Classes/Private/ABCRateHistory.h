@@ -0,0 +1,37 @@
+//
+// ABCRateHistory.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+//
+// On-disk history of BTC exchange rates, one file per currency number under
+// <rootDirectory>/Rates/<num>.rates. A file is an array of fixed-width 16 byte records
+// in native byte order, sorted by time:
+//
+//   int64_t    timestamp   unix seconds
+//   double     rate        fiat per BTC
+//
+// Records are only appended. Reads memory map the file and binary search it.
+//
+@interface ABCRateHistory : NSObject
+
+- (id)initWithDirectory:(NSString *)directory;
+
+// Appends a record unless the newest one is less than the minimum spacing older than timestamp
+- (void)addRate:(double)rate timestamp:(int64_t)timestamp currencyNum:(int)num;
+
+// Rate of the newest record at or before timestamp. 0 if timestamp is before the first
+// record or there is no history.
+- (double)rateAtTimestamp:(int64_t)timestamp currencyNum:(int)num;
+
+// Fills rates[i] with rateAtTimestamp:timestamps[i]. Sorted input, in either direction,
+// is walked with one moving cursor. Unsorted input falls back to a binary search per entry.
+- (void)ratesAtTimestamps:(const int64_t *)timestamps
+                    count:(NSUInteger)count
+              currencyNum:(int)num
+                    rates:(double *)rates;
+
+@end
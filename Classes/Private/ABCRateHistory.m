@@ -0,0 +1,186 @@
+//
+// ABCRateHistory.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCRateHistory.h"
+#import "ABCContext.h"
+#import <fcntl.h>
+#import <unistd.h>
+#import <sys/stat.h>
+
+// Rates are refreshed every minute or so. Keep at most one record per this many seconds.
+static const int64_t rateHistoryMinSpacingSeconds = 15 * 60;
+
+typedef struct
+{
+    int64_t     timestamp;
+    double      rate;
+} tRateRecord;
+
+@interface ABCRateHistory ()
+{
+    NSString            *_directory;
+    NSMutableDictionary *_mapped;       // currency number -> mapped NSData of its file
+}
+
+@end
+
+@implementation ABCRateHistory
+
+- (id)initWithDirectory:(NSString *)directory
+{
+    self = [super init];
+    if (self)
+    {
+        _directory = [directory copy];
+        _mapped = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+- (NSString *)pathForCurrencyNum:(int)num
+{
+    return [_directory stringByAppendingPathComponent:[NSString stringWithFormat:@"%d.rates", num]];
+}
+
+- (NSData *)recordsForCurrencyNum:(int)num
+{
+    @synchronized(self)
+    {
+        NSNumber *key = [NSNumber numberWithInt:num];
+        NSData *data = [_mapped objectForKey:key];
+        if (!data)
+        {
+            data = [NSData dataWithContentsOfFile:[self pathForCurrencyNum:num]
+                                          options:NSDataReadingMappedIfSafe
+                                            error:nil];
+            if (!data)
+                data = [[NSData alloc] init];
+            [_mapped setObject:data forKey:key];
+        }
+        return data;
+    }
+}
+
+- (void)addRate:(double)rate timestamp:(int64_t)timestamp currencyNum:(int)num
+{
+    if (rate <= 0)
+        return;
+    
+    @synchronized(self)
+    {
+        NSData *data = [self recordsForCurrencyNum:num];
+        NSUInteger count = [data length] / sizeof(tRateRecord);
+        const tRateRecord *records = [data bytes];
+        if (count && timestamp - records[count - 1].timestamp < rateHistoryMinSpacingSeconds)
+            return;
+        
+        // Plain file descriptor calls so that a full disk or other I/O error just
+        // loses this record instead of raising an exception
+        NSString *path = [self pathForCurrencyNum:num];
+        [[NSFileManager defaultManager] createDirectoryAtPath:_directory
+                                  withIntermediateDirectories:YES attributes:nil error:nil];
+        int fd = open([path fileSystemRepresentation], O_WRONLY | O_CREAT, 0644);
+        if (fd < 0)
+            return;
+        
+        // Drop a partial record left by an interrupted write
+        struct stat st;
+        off_t size = fstat(fd, &st) == 0 ? st.st_size : -1;
+        if (size >= 0 && size % sizeof(tRateRecord))
+        {
+            size -= size % sizeof(tRateRecord);
+            if (ftruncate(fd, size) != 0)
+                size = -1;
+        }
+        if (size >= 0)
+        {
+            tRateRecord record = { timestamp, rate };
+            if (pwrite(fd, &record, sizeof(record), size) != (ssize_t) sizeof(record))
+            {
+                ABCLog(1, @"Failed to record rate for currency %d: %s", num, strerror(errno));
+                (void) ftruncate(fd, size);
+            }
+        }
+        close(fd);
+        
+        // Remap on next read
+        [_mapped removeObjectForKey:[NSNumber numberWithInt:num]];
+    }
+}
+
+// Index of the newest record with timestamp <= ts, or 0 if ts is before all of them.
+// Callers check records[0].timestamp for the second case.
+static NSUInteger recordIndexAt(const tRateRecord *records, NSUInteger count, int64_t ts)
+{
+    NSUInteger lo = 0, hi = count;
+    while (lo < hi)
+    {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if (records[mid].timestamp <= ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo ? lo - 1 : 0;
+}
+
+- (double)rateAtTimestamp:(int64_t)timestamp currencyNum:(int)num
+{
+    double rate = 0;
+    [self ratesAtTimestamps:&timestamp count:1 currencyNum:num rates:&rate];
+    return rate;
+}
+
+- (void)ratesAtTimestamps:(const int64_t *)timestamps
+                    count:(NSUInteger)count
+              currencyNum:(int)num
+                    rates:(double *)rates
+{
+    NSData *data = [self recordsForCurrencyNum:num];
+    NSUInteger n = [data length] / sizeof(tRateRecord);
+    const tRateRecord *records = [data bytes];
+    if (!n)
+    {
+        memset(rates, 0, count * sizeof(double));
+        return;
+    }
+    
+    BOOL bAscending = YES, bDescending = YES;
+    for (NSUInteger i = 1; i < count; i++)
+    {
+        if (timestamps[i] < timestamps[i - 1]) bAscending = NO;
+        if (timestamps[i] > timestamps[i - 1]) bDescending = NO;
+    }
+    
+    if (count && (bAscending || bDescending))
+    {
+        // Start from a binary search and then move the cursor one way
+        NSUInteger r = recordIndexAt(records, n, timestamps[0]);
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            int64_t ts = timestamps[i];
+            if (bAscending)
+            {
+                while (r + 1 < n && records[r + 1].timestamp <= ts) r++;
+            }
+            else
+            {
+                while (r > 0 && records[r].timestamp > ts) r--;
+            }
+            rates[i] = records[r].timestamp <= ts ? records[r].rate : 0;
+        }
+    }
+    else
+    {
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            NSUInteger r = recordIndexAt(records, n, timestamps[i]);
+            rates[i] = records[r].timestamp <= timestamps[i] ? records[r].rate : 0;
+        }
+    }
+}
+
+@end
@@ -0,0 +1,53 @@
+//
+// ABCScheduler.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSUInteger, ABCSchedulerPriority) {
+    // User initiated work that must return quickly (QR codes, spends, lookups)
+    ABCSchedulerPriorityInteractive = 0,
+    // Reloading wallets and transactions for display
+    ABCSchedulerPriorityUIRefresh,
+    // Network data syncs
+    ABCSchedulerPrioritySync,
+    // Watcher start/stop and other housekeeping
+    ABCSchedulerPriorityBackground,
+    ABCSchedulerPriorityCount
+};
+
+//
+// Runs blocks in one of several priority classes. Each class has its own
+// concurrency limit and quality of service so that interactive and UI work never
+// waits behind a long running sync. Posting returns the NSOperation which doubles
+// as a cancellation token.
+//
+@interface ABCScheduler : NSObject
+
+- (id)init;
+- (void)setMaxConcurrent:(NSInteger)max forPriority:(ABCSchedulerPriority)priority;
+- (NSOperation *)post:(void(^)(void))cb priority:(ABCSchedulerPriority)priority;
+
+// Runs cb only after 'after' has finished or been cancelled. 'after' may be nil.
+- (NSOperation *)post:(void(^)(void))cb priority:(ABCSchedulerPriority)priority after:(NSOperation *)after;
+
+// Queues an operation the caller built itself, for when the operation has to be set up
+// before it can start running.
+- (void)addOperation:(NSOperation *)op priority:(ABCSchedulerPriority)priority;
+- (void)cancelPriority:(ABCSchedulerPriority)priority;
+- (void)cancelAll;
+- (NSUInteger)operationCountForPriority:(ABCSchedulerPriority)priority;
+- (NSUInteger)operationCount;
+
+// Blocks until every operation already posted to the given priority classes (NSNumber
+// ABCSchedulerPriority values) has finished or been cancelled. Pass a negative timeout
+// to wait forever. Returns NO if the timeout expired first.
+- (BOOL)waitUntilIdle:(NSArray *)priorities timeout:(NSTimeInterval)timeout;
+- (BOOL)waitUntilIdle:(NSTimeInterval)timeout;
+
+// Same as waitUntilIdle:timeout: for a standalone NSOperationQueue
++ (BOOL)waitForQueue:(NSOperationQueue *)queue timeout:(NSTimeInterval)timeout;
+
+@end
@@ -0,0 +1,172 @@
+//
+// ABCScheduler.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCScheduler.h"
+
+@interface ABCScheduler ()
+{
+    NSArray *queues;
+}
+
+@end
+
+@implementation ABCScheduler
+
+- (id)init
+{
+    self = [super init];
+    if (self)
+    {
+        static const NSInteger defaultMaxConcurrent[ABCSchedulerPriorityCount] = { 8, 1, 1, 1 };
+        static NSString *const names[ABCSchedulerPriorityCount] = { @"interactive", @"uirefresh", @"sync", @"background" };
+
+        NSMutableArray *array = [[NSMutableArray alloc] init];
+        for (NSUInteger i = 0; i < ABCSchedulerPriorityCount; i++)
+        {
+            NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+            [queue setMaxConcurrentOperationCount:defaultMaxConcurrent[i]];
+            queue.name = [NSString stringWithFormat:@"ABCScheduler.%@", names[i]];
+            if ([queue respondsToSelector:@selector(setQualityOfService:)])
+            {
+                static const NSQualityOfService qos[ABCSchedulerPriorityCount] = {
+                    NSQualityOfServiceUserInitiated,
+                    NSQualityOfServiceUserInitiated,
+                    NSQualityOfServiceUtility,
+                    NSQualityOfServiceBackground,
+                };
+                queue.qualityOfService = qos[i];
+            }
+            [array addObject:queue];
+        }
+        queues = [array copy];
+    }
+    return self;
+}
+
+- (NSOperationQueue *)queueForPriority:(ABCSchedulerPriority)priority
+{
+    if (priority >= ABCSchedulerPriorityCount)
+        priority = ABCSchedulerPriorityBackground;
+    return queues[priority];
+}
+
+- (void)setMaxConcurrent:(NSInteger)max forPriority:(ABCSchedulerPriority)priority
+{
+    [[self queueForPriority:priority] setMaxConcurrentOperationCount:max];
+}
+
+- (NSOperation *)post:(void(^)(void))cb priority:(ABCSchedulerPriority)priority
+{
+    return [self post:cb priority:priority after:nil];
+}
+
+- (NSOperation *)post:(void(^)(void))cb priority:(ABCSchedulerPriority)priority after:(NSOperation *)after
+{
+    if (!cb) return nil;
+
+    NSBlockOperation *op = [NSBlockOperation blockOperationWithBlock:cb];
+    if (priority == ABCSchedulerPriorityInteractive)
+        op.queuePriority = NSOperationQueuePriorityHigh;
+    if (after && !after.isFinished)
+        [op addDependency:after];
+    [self addOperation:op priority:priority];
+    return op;
+}
+
+- (void)addOperation:(NSOperation *)op priority:(ABCSchedulerPriority)priority
+{
+    if (!op) return;
+    [[self queueForPriority:priority] addOperation:op];
+}
+
+- (void)cancelPriority:(ABCSchedulerPriority)priority
+{
+    [[self queueForPriority:priority] cancelAllOperations];
+}
+
+- (void)cancelAll
+{
+    for (NSOperationQueue *queue in queues)
+        [queue cancelAllOperations];
+}
+
+- (NSUInteger)operationCountForPriority:(ABCSchedulerPriority)priority
+{
+    return [[self queueForPriority:priority] operationCount];
+}
+
+- (NSUInteger)operationCount
+{
+    NSUInteger total = 0;
+    for (NSOperationQueue *queue in queues)
+        total += [queue operationCount];
+    return total;
+}
+
+//
+// Waiting is done with a sentinel operation that depends on everything currently in
+// the queue. It runs on a private queue, so it still fires after the watched queue
+// has been cancelled, and it leaves the dispatch group as soon as the last
+// in-flight operation finishes.
+//
++ (NSOperationQueue *)sentinelQueue
+{
+    static NSOperationQueue *sentinelQueue = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        sentinelQueue = [[NSOperationQueue alloc] init];
+        sentinelQueue.name = @"ABCScheduler.sentinel";
+    });
+    return sentinelQueue;
+}
+
++ (void)addSentinelForQueue:(NSOperationQueue *)queue group:(dispatch_group_t)group
+{
+    NSArray *operations = [queue operations];
+    if ([operations count] == 0)
+        return;
+
+    dispatch_group_enter(group);
+    NSBlockOperation *sentinel = [NSBlockOperation blockOperationWithBlock:^{
+        dispatch_group_leave(group);
+    }];
+    for (NSOperation *op in operations)
+        [sentinel addDependency:op];
+    [[self sentinelQueue] addOperation:sentinel];
+}
+
++ (BOOL)waitForGroup:(dispatch_group_t)group timeout:(NSTimeInterval)timeout
+{
+    dispatch_time_t when = timeout < 0 ? DISPATCH_TIME_FOREVER :
+        dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC));
+    return dispatch_group_wait(group, when) == 0;
+}
+
++ (BOOL)waitForQueue:(NSOperationQueue *)queue timeout:(NSTimeInterval)timeout
+{
+    if (!queue) return YES;
+    dispatch_group_t group = dispatch_group_create();
+    [self addSentinelForQueue:queue group:group];
+    return [self waitForGroup:group timeout:timeout];
+}
+
+- (BOOL)waitUntilIdle:(NSArray *)priorities timeout:(NSTimeInterval)timeout
+{
+    dispatch_group_t group = dispatch_group_create();
+    for (NSNumber *priority in priorities)
+        [ABCScheduler addSentinelForQueue:[self queueForPriority:[priority unsignedIntegerValue]] group:group];
+    return [ABCScheduler waitForGroup:group timeout:timeout];
+}
+
+- (BOOL)waitUntilIdle:(NSTimeInterval)timeout
+{
+    dispatch_group_t group = dispatch_group_create();
+    for (NSOperationQueue *queue in queues)
+        [ABCScheduler addSentinelForQueue:queue group:group];
+    return [ABCScheduler waitForGroup:group timeout:timeout];
+}
+
+@end
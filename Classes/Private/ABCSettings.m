@@ -129,6 +129,7 @@
                 ABC_FreeAccountSettings(pSettings);
                 [self.keyChain disableKeychainBasedOnSettings:self.account.name];
                 [self.local saveAll];
+                [self.account dataSyncAccount];
             }
             if (self.account.delegate)
             {
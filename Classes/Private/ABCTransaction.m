@@ -88,7 +88,9 @@
             return;
         }
         
-        [self.wallet.account refreshWallets];
+        [self.wallet markTransactionDirty:self.txid];
+        [self.wallet.account refreshWallet:self.wallet.uuid];
+        [self.wallet.account requestWalletDataSync:self.wallet.uuid];
         return;
     }];
 }
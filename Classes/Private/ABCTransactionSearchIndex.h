@@ -0,0 +1,33 @@
+//
+// ABCTransactionSearchIndex.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class ABCTransaction;
+
+//
+// In-memory inverted index over a wallet's transactions. Terms come from payee name,
+// category, notes, txid, input/output addresses and the amount, in satoshis, BTC, mBTC
+// and bits. Every query word is matched as a prefix. Results are ordered newest first.
+// The index is kept up to date by passing it each new transaction list, and only
+// transactions whose searchable text changed are re-indexed.
+//
+@interface ABCTransactionSearchIndex : NSObject
+
+// The list last passed to init or updateTransactions:
+@property (atomic, strong, readonly)  NSArray     *indexedTransactions;
+
+- (id)initWithTransactions:(NSArray *)arrayTransactions;
+
+// Diffs against the indexed transactions by txid. Transactions whose terms are
+// unchanged only have their object swapped. Added, changed or removed ones are
+// re-indexed.
+- (void)updateTransactions:(NSArray *)arrayTransactions;
+
+// Transactions matching every word of query as a prefix, newest first. limit 0 means no limit.
+- (NSArray *)search:(NSString *)query limit:(NSUInteger)limit;
+
+@end
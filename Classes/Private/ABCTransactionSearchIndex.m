@@ -0,0 +1,294 @@
+//
+// ABCTransactionSearchIndex.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCTransactionSearchIndex.h"
+#import "ABCTransaction.h"
+#import "ABCMetadata.h"
+#import "ABCTxInOut.h"
+
+@interface ABCTransactionSearchIndex ()
+{
+    // Each indexed transaction gets a stable document id. Postings are sets of ids.
+    // Ids of removed transactions are reused, so docs never grows past the largest
+    // number of transactions indexed at once.
+    NSMutableArray          *docs;          // doc id -> ABCTransaction or NSNull while free
+    NSMutableArray          *docTerms;      // doc id -> NSSet of terms
+    NSMutableIndexSet       *freeDocIds;
+    NSMutableDictionary     *docByTxid;     // txid -> NSNumber doc id
+    NSMutableDictionary     *postings;      // term -> NSMutableIndexSet of doc ids
+    NSArray                 *sortedTerms;   // rebuilt lazily after new terms are added
+}
+
+@property (atomic, strong)  NSArray     *indexedTransactions;
+
+@end
+
+@implementation ABCTransactionSearchIndex
+
+- (id)initWithTransactions:(NSArray *)arrayTransactions
+{
+    self = [super init];
+    if (self)
+    {
+        docs = [[NSMutableArray alloc] initWithCapacity:[arrayTransactions count]];
+        docTerms = [[NSMutableArray alloc] initWithCapacity:[arrayTransactions count]];
+        freeDocIds = [[NSMutableIndexSet alloc] init];
+        docByTxid = [[NSMutableDictionary alloc] initWithCapacity:[arrayTransactions count]];
+        postings = [[NSMutableDictionary alloc] init];
+        for (ABCTransaction *t in arrayTransactions)
+            [self addTransaction:t terms:[self termsForTransaction:t]];
+        self.indexedTransactions = arrayTransactions;
+    }
+    return self;
+}
+
+#pragma mark - Tokenizing
+
+static NSString *normalize(NSString *s)
+{
+    return [s stringByFoldingWithOptions:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch
+                                  locale:nil];
+}
+
+static void addWords(NSMutableSet *terms, NSString *text)
+{
+    if (![text length]) return;
+    static NSCharacterSet *separators = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        separators = [[NSCharacterSet alphanumericCharacterSet] invertedSet];
+    });
+    for (NSString *word in [normalize(text) componentsSeparatedByCharactersInSet:separators])
+    {
+        if ([word length])
+            [terms addObject:word];
+    }
+}
+
+// Amount in units of 10^places satoshi with trailing zeros dropped
+static NSString *decimalString(uint64_t satoshi, int places)
+{
+    uint64_t unit = 1;
+    for (int i = 0; i < places; i++) unit *= 10;
+    NSString *s = [NSString stringWithFormat:@"%llu.%0*llu", satoshi / unit, places, satoshi % unit];
+    // Drop trailing zeros and a bare decimal point
+    NSUInteger end = [s length];
+    while (end > 0 && [s characterAtIndex:end - 1] == '0') end--;
+    if (end > 0 && [s characterAtIndex:end - 1] == '.') end--;
+    return [s substringToIndex:end];
+}
+
+- (NSSet *)termsForTransaction:(ABCTransaction *)t
+{
+    NSMutableSet *terms = [[NSMutableSet alloc] init];
+    addWords(terms, t.metaData.payeeName);
+    addWords(terms, t.metaData.category);
+    addWords(terms, t.metaData.notes);
+    if ([t.txid length])
+        [terms addObject:[t.txid lowercaseString]];
+    for (ABCTxInOut *io in t.inputOutputList)
+    {
+        if ([io.address length])
+            [terms addObject:[io.address lowercaseString]];
+    }
+    if (t.amountSatoshi != 0)
+    {
+        // Satoshi, BTC, mBTC and bits, so the amount matches whatever denomination it is typed in
+        uint64_t abs = t.amountSatoshi < 0 ? (uint64_t) -t.amountSatoshi : (uint64_t) t.amountSatoshi;
+        [terms addObject:[NSString stringWithFormat:@"%llu", abs]];
+        [terms addObject:decimalString(abs, 8)];
+        [terms addObject:decimalString(abs, 5)];
+        [terms addObject:decimalString(abs, 2)];
+    }
+    return terms;
+}
+
+// Numbers are kept whole so "0.0015" matches the amount. Other words are split the
+// same way as the indexed text.
+- (NSArray *)queryTerms:(NSString *)query
+{
+    static NSCharacterSet *numeric = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        numeric = [[NSCharacterSet characterSetWithCharactersInString:@"0123456789."] invertedSet];
+    });
+    
+    NSMutableSet *terms = [[NSMutableSet alloc] init];
+    for (NSString *word in [query componentsSeparatedByCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]])
+    {
+        if (![word length])
+            continue;
+        if ([word rangeOfCharacterFromSet:numeric].location == NSNotFound)
+            [terms addObject:word];
+        else
+            addWords(terms, word);
+    }
+    return [terms allObjects];
+}
+
+#pragma mark - Maintenance
+
+- (void)addTransaction:(ABCTransaction *)t terms:(NSSet *)terms
+{
+    if (![t.txid length]) return;
+    
+    NSUInteger docId = [freeDocIds firstIndex];
+    if (docId != NSNotFound)
+    {
+        [freeDocIds removeIndex:docId];
+        docs[docId] = t;
+        docTerms[docId] = terms;
+    }
+    else
+    {
+        docId = [docs count];
+        [docs addObject:t];
+        [docTerms addObject:terms];
+    }
+    [docByTxid setObject:[NSNumber numberWithUnsignedInteger:docId] forKey:t.txid];
+    for (NSString *term in terms)
+    {
+        NSMutableIndexSet *set = [postings objectForKey:term];
+        if (!set)
+        {
+            set = [[NSMutableIndexSet alloc] init];
+            [postings setObject:set forKey:term];
+            sortedTerms = nil;
+        }
+        [set addIndex:docId];
+    }
+}
+
+- (void)removeTxid:(NSString *)txid
+{
+    NSNumber *docId = [docByTxid objectForKey:txid];
+    if (!docId) return;
+    
+    NSUInteger i = [docId unsignedIntegerValue];
+    for (NSString *term in docTerms[i])
+    {
+        NSMutableIndexSet *set = [postings objectForKey:term];
+        [set removeIndex:i];
+        if ([set count] == 0)
+        {
+            [postings removeObjectForKey:term];
+            sortedTerms = nil;
+        }
+    }
+    docs[i] = [NSNull null];
+    docTerms[i] = [NSSet set];
+    [freeDocIds addIndex:i];
+    [docByTxid removeObjectForKey:txid];
+}
+
+- (void)updateTransactions:(NSArray *)arrayTransactions
+{
+    @synchronized(self)
+    {
+        if (arrayTransactions == self.indexedTransactions)
+            return;
+        
+        NSMutableSet *seen = [[NSMutableSet alloc] initWithCapacity:[arrayTransactions count]];
+        for (ABCTransaction *t in arrayTransactions)
+        {
+            if (![t.txid length]) continue;
+            [seen addObject:t.txid];
+            NSNumber *docId = [docByTxid objectForKey:t.txid];
+            if (docId && docs[[docId unsignedIntegerValue]] == t)
+                continue;
+            
+            // A reload makes new objects for every transaction. Only re-index the
+            // ones whose searchable text actually changed.
+            NSSet *terms = [self termsForTransaction:t];
+            if (docId && [docTerms[[docId unsignedIntegerValue]] isEqualToSet:terms])
+            {
+                docs[[docId unsignedIntegerValue]] = t;
+                continue;
+            }
+            [self removeTxid:t.txid];
+            [self addTransaction:t terms:terms];
+        }
+        if ([docByTxid count] > [seen count])
+        {
+            for (NSString *txid in [docByTxid allKeys])
+            {
+                if (![seen containsObject:txid])
+                    [self removeTxid:txid];
+            }
+        }
+        self.indexedTransactions = arrayTransactions;
+    }
+}
+
+#pragma mark - Query
+
+// Union of postings for every term starting with prefix
+- (NSIndexSet *)docsForPrefix:(NSString *)prefix
+{
+    if (!sortedTerms)
+        sortedTerms = [[postings allKeys] sortedArrayUsingSelector:@selector(compare:)];
+    
+    NSUInteger lo = 0, hi = [sortedTerms count];
+    while (lo < hi)
+    {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if ([sortedTerms[mid] compare:prefix] == NSOrderedAscending)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    
+    NSMutableIndexSet *result = [[NSMutableIndexSet alloc] init];
+    for (NSUInteger i = lo; i < [sortedTerms count] && [sortedTerms[i] hasPrefix:prefix]; i++)
+        [result addIndexes:[postings objectForKey:sortedTerms[i]]];
+    return result;
+}
+
+- (NSArray *)search:(NSString *)query limit:(NSUInteger)limit
+{
+    NSArray *terms = [self queryTerms:query];
+    if (![terms count])
+        return [[NSArray alloc] init];
+    
+    NSMutableArray *results = [[NSMutableArray alloc] init];
+    @synchronized(self)
+    {
+        // Start with the most selective term
+        NSMutableArray *sets = [[NSMutableArray alloc] initWithCapacity:[terms count]];
+        for (NSString *term in terms)
+        {
+            NSIndexSet *set = [self docsForPrefix:term];
+            if ([set count] == 0)
+                return results;
+            [sets addObject:set];
+        }
+        [sets sortUsingComparator:^NSComparisonResult(NSIndexSet *a, NSIndexSet *b) {
+            return a.count < b.count ? NSOrderedAscending : (a.count > b.count ? NSOrderedDescending : NSOrderedSame);
+        }];
+        
+        NSMutableIndexSet *matches = [sets[0] mutableCopy];
+        for (NSUInteger i = 1; i < [sets count] && [matches count]; i++)
+        {
+            NSIndexSet *other = sets[i];
+            [matches removeIndexes:[matches indexesPassingTest:^BOOL(NSUInteger idx, BOOL *stop) {
+                return ![other containsIndex:idx];
+            }]];
+        }
+        
+        [matches enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *stop) {
+            [results addObject:docs[idx]];
+        }];
+    }
+    
+    [results sortUsingComparator:^NSComparisonResult(ABCTransaction *a, ABCTransaction *b) {
+        return [b.date compare:a.date];
+    }];
+    if (limit && [results count] > limit)
+        [results removeObjectsInRange:NSMakeRange(limit, [results count] - limit)];
+    return results;
+}
+
+@end
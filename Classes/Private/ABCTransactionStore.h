@@ -0,0 +1,59 @@
+//
+// ABCTransactionStore.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class ABCTransaction;
+
+//
+// Immutable column oriented copy of a wallet's transactions. The numeric fields live in
+// contiguous int64_t arrays ordered newest first, the same order as arrayTransactions,
+// so sums and range queries run as tight loops instead of walking ABCTransaction
+// objects. The objects are only touched when a caller asks for one by index.
+//
+@interface ABCTransactionStore : NSObject
+
+@property (nonatomic, readonly) NSUInteger      count;
+@property (nonatomic, readonly) const int64_t   *timestamps;
+@property (nonatomic, readonly) const int64_t   *amounts;
+@property (nonatomic, readonly) const int64_t   *balances;
+@property (nonatomic, readonly) const int64_t   *heights;
+@property (nonatomic, readonly) const int64_t   *minerFees;
+@property (nonatomic, readonly) const int64_t   *providerFees;
+
+// arrayTransactions must be sorted newest first
+- (id)initWithTransactions:(NSArray *)arrayTransactions;
+
+// Same as above, but the last unchangedTail transactions are the same, with the same
+// balances, as the last unchangedTail of previous. Their columns and sums are copied
+// from previous and only the new head is read from the transaction objects.
+- (id)initWithTransactions:(NSArray *)arrayTransactions
+                  previous:(ABCTransactionStore *)previous
+             unchangedTail:(NSUInteger)unchangedTail;
+- (ABCTransaction *)transactionAtIndex:(NSUInteger)index;
+
+// Index of the first (newest) transaction with a timestamp before ts
+- (NSUInteger)indexBeforeTimestamp:(int64_t)ts;
+
+// Sums over transactions with timestamps in [start, end)
+- (int64_t)sumAmountsFrom:(int64_t)start to:(int64_t)end;
+- (int64_t)totalSentFrom:(int64_t)start to:(int64_t)end;
+- (int64_t)totalReceivedFrom:(int64_t)start to:(int64_t)end;
+- (int64_t)totalFeesFrom:(int64_t)start to:(int64_t)end;
+
+// Total sent by transactions stamped at or after ts. O(log n).
+- (int64_t)totalSentSince:(int64_t)ts;
+
+// Total sent on the last 'days' calendar days, including today, in the current
+// calendar's time zone. Day boundaries are cached per time zone so this is O(1) after
+// the first call.
+- (int64_t)totalSentInLastDays:(NSUInteger)days;
+
+// Indexes of transactions with timestamps in [start, end) whose amount is at least minAmount
+// in absolute value. Pass direction < 0 for sends only, > 0 for receives only, 0 for both.
+- (NSIndexSet *)indexesFrom:(int64_t)start to:(int64_t)end direction:(int)direction minAmount:(int64_t)minAmount;
+
+@end
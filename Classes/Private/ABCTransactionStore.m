@@ -0,0 +1,271 @@
+//
+// ABCTransactionStore.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCTransactionStore.h"
+#import "ABCTransaction.h"
+
+enum
+{
+    kColumnTimestamp = 0,
+    kColumnAmount,
+    kColumnBalance,
+    kColumnHeight,
+    kColumnMinerFee,
+    kColumnProviderFee,
+    kColumnSentSuffix,      // count + 1 entries. sentSuffix[i] = total sent by transactions [i, count)
+    kColumnCount
+};
+
+@interface ABCTransactionStore ()
+{
+    int64_t     *_columns;
+    NSArray     *_transactions;
+    NSUInteger  _count;
+    
+    // dayStartIndex[d] is the index of the first transaction before the start of day
+    // firstDay + d, for every day from the oldest transaction to the day after the newest
+    NSUInteger  *_dayStartIndex;
+    NSInteger   _firstDay;
+    NSUInteger  _dayCount;
+    NSTimeZone  *_dayTimeZone;
+}
+
+@end
+
+@implementation ABCTransactionStore
+
+- (id)initWithTransactions:(NSArray *)arrayTransactions
+{
+    return [self initWithTransactions:arrayTransactions previous:nil unchangedTail:0];
+}
+
+- (id)initWithTransactions:(NSArray *)arrayTransactions
+                  previous:(ABCTransactionStore *)previous
+             unchangedTail:(NSUInteger)unchangedTail
+{
+    self = [super init];
+    if (self)
+    {
+        _transactions = arrayTransactions ? arrayTransactions : [[NSArray alloc] init];
+        _count = [_transactions count];
+        // One allocation with the columns laid out back to back
+        _columns = calloc((_count + 1) * kColumnCount, sizeof(int64_t));
+        if (!_columns) return nil;
+        
+        if (!previous || unchangedTail > previous->_count)
+            unchangedTail = 0;
+        if (unchangedTail > _count)
+            unchangedTail = _count;
+        NSUInteger head = _count - unchangedTail;
+        
+        // The unchanged tail is copied column by column from the previous store,
+        // suffix sums included, since the sums over older transactions do not change
+        if (unchangedTail)
+        {
+            NSUInteger from = previous->_count - unchangedTail;
+            for (int c = 0; c < kColumnCount; c++)
+            {
+                NSUInteger len = (c == kColumnSentSuffix) ? unchangedTail + 1 : unchangedTail;
+                memcpy(_columns + c * _count + head,
+                       previous->_columns + c * previous->_count + from,
+                       len * sizeof(int64_t));
+            }
+        }
+        
+        int64_t *ts = _columns + kColumnTimestamp * _count;
+        int64_t *amount = _columns + kColumnAmount * _count;
+        int64_t *balance = _columns + kColumnBalance * _count;
+        int64_t *height = _columns + kColumnHeight * _count;
+        int64_t *minerFee = _columns + kColumnMinerFee * _count;
+        int64_t *providerFee = _columns + kColumnProviderFee * _count;
+        
+        for (NSUInteger i = 0; i < head; i++)
+        {
+            ABCTransaction *t = _transactions[i];
+            ts[i] = (int64_t) [t.date timeIntervalSince1970];
+            amount[i] = t.amountSatoshi;
+            balance[i] = t.balance;
+            height[i] = t.height;
+            minerFee[i] = t.minerFees;
+            providerFee[i] = t.providerFee;
+        }
+        
+        int64_t *sentSuffix = _columns + kColumnSentSuffix * _count;
+        if (!unchangedTail)
+            sentSuffix[_count] = 0;
+        for (NSInteger j = (NSInteger) head - 1; j >= 0; j--)
+            sentSuffix[j] = sentSuffix[j + 1] + (amount[j] < 0 ? -amount[j] : 0);
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_columns);
+    free(_dayStartIndex);
+}
+
+- (NSUInteger)count { return _count; }
+- (const int64_t *)timestamps { return _columns + kColumnTimestamp * _count; }
+- (const int64_t *)amounts { return _columns + kColumnAmount * _count; }
+- (const int64_t *)balances { return _columns + kColumnBalance * _count; }
+- (const int64_t *)heights { return _columns + kColumnHeight * _count; }
+- (const int64_t *)minerFees { return _columns + kColumnMinerFee * _count; }
+- (const int64_t *)providerFees { return _columns + kColumnProviderFee * _count; }
+
+- (ABCTransaction *)transactionAtIndex:(NSUInteger)index
+{
+    return index < _count ? _transactions[index] : nil;
+}
+
+- (NSUInteger)indexBeforeTimestamp:(int64_t)ts
+{
+    const int64_t *timestamps = self.timestamps;
+    NSUInteger lo = 0, hi = _count;
+    while (lo < hi)
+    {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if (timestamps[mid] >= ts)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+- (NSRange)rangeFrom:(int64_t)start to:(int64_t)end
+{
+    NSUInteger first = [self indexBeforeTimestamp:end];
+    NSUInteger last = [self indexBeforeTimestamp:start];
+    if (last < first) last = first;
+    return NSMakeRange(first, last - first);
+}
+
+- (int64_t)sumAmountsFrom:(int64_t)start to:(int64_t)end
+{
+    NSRange r = [self rangeFrom:start to:end];
+    const int64_t *amounts = self.amounts;
+    int64_t total = 0;
+    for (NSUInteger i = r.location; i < NSMaxRange(r); i++)
+        total += amounts[i];
+    return total;
+}
+
+- (int64_t)totalSentFrom:(int64_t)start to:(int64_t)end
+{
+    NSRange r = [self rangeFrom:start to:end];
+    const int64_t *amounts = self.amounts;
+    int64_t total = 0;
+    for (NSUInteger i = r.location; i < NSMaxRange(r); i++)
+        if (amounts[i] < 0)
+            total -= amounts[i];
+    return total;
+}
+
+- (int64_t)totalReceivedFrom:(int64_t)start to:(int64_t)end
+{
+    NSRange r = [self rangeFrom:start to:end];
+    const int64_t *amounts = self.amounts;
+    int64_t total = 0;
+    for (NSUInteger i = r.location; i < NSMaxRange(r); i++)
+        if (amounts[i] > 0)
+            total += amounts[i];
+    return total;
+}
+
+- (int64_t)totalFeesFrom:(int64_t)start to:(int64_t)end
+{
+    NSRange r = [self rangeFrom:start to:end];
+    const int64_t *minerFees = self.minerFees;
+    const int64_t *providerFees = self.providerFees;
+    int64_t total = 0;
+    for (NSUInteger i = r.location; i < NSMaxRange(r); i++)
+        total += minerFees[i] + providerFees[i];
+    return total;
+}
+
+- (int64_t)totalSentSince:(int64_t)ts
+{
+    const int64_t *sentSuffix = _columns + kColumnSentSuffix * _count;
+    return sentSuffix[0] - sentSuffix[[self indexBeforeTimestamp:ts]];
+}
+
+// Rebuilds the day table when first needed or after the time zone changes. DST is
+// handled by asking the calendar for each day start rather than adding 86400.
+- (void)buildDayTable:(NSCalendar *)calendar
+{
+    free(_dayStartIndex);
+    _dayStartIndex = NULL;
+    _dayCount = 0;
+    _dayTimeZone = calendar.timeZone;
+    if (_count == 0)
+        return;
+    
+    const int64_t *timestamps = self.timestamps;
+    NSDate *oldest = [NSDate dateWithTimeIntervalSince1970:timestamps[_count - 1]];
+    NSDate *newest = [NSDate dateWithTimeIntervalSince1970:timestamps[0]];
+    _firstDay = [calendar ordinalityOfUnit:NSCalendarUnitDay inUnit:NSCalendarUnitEra forDate:oldest];
+    NSInteger lastDay = [calendar ordinalityOfUnit:NSCalendarUnitDay inUnit:NSCalendarUnitEra forDate:newest];
+    
+    _dayCount = (NSUInteger) (lastDay - _firstDay + 2);
+    _dayStartIndex = malloc(_dayCount * sizeof(NSUInteger));
+    if (!_dayStartIndex)
+    {
+        _dayCount = 0;
+        return;
+    }
+    
+    NSDate *day = [calendar startOfDayForDate:oldest];
+    for (NSUInteger d = 0; d < _dayCount; d++)
+    {
+        _dayStartIndex[d] = [self indexBeforeTimestamp:(int64_t) [day timeIntervalSince1970]];
+        day = [calendar dateByAddingUnit:NSCalendarUnitDay value:1 toDate:day options:0];
+    }
+}
+
+- (int64_t)totalSentInLastDays:(NSUInteger)days
+{
+    if (_count == 0 || days == 0)
+        return 0;
+    
+    NSCalendar *calendar = [NSCalendar currentCalendar];
+    NSUInteger index;
+    @synchronized(self)
+    {
+        if (!_dayTimeZone || ![_dayTimeZone isEqualToTimeZone:calendar.timeZone])
+            [self buildDayTable:calendar];
+        
+        NSInteger today = [calendar ordinalityOfUnit:NSCalendarUnitDay inUnit:NSCalendarUnitEra forDate:[NSDate date]];
+        NSInteger startDay = today - (NSInteger) days + 1;
+        if (startDay < _firstDay)
+            index = _count;
+        else if (startDay - _firstDay >= (NSInteger) _dayCount)
+            index = 0;
+        else
+            index = _dayStartIndex[startDay - _firstDay];
+    }
+    const int64_t *sentSuffix = _columns + kColumnSentSuffix * _count;
+    return sentSuffix[0] - sentSuffix[index];
+}
+
+- (NSIndexSet *)indexesFrom:(int64_t)start to:(int64_t)end direction:(int)direction minAmount:(int64_t)minAmount
+{
+    NSRange r = [self rangeFrom:start to:end];
+    const int64_t *amounts = self.amounts;
+    NSMutableIndexSet *indexes = [[NSMutableIndexSet alloc] init];
+    for (NSUInteger i = r.location; i < NSMaxRange(r); i++)
+    {
+        int64_t a = amounts[i];
+        if ((direction < 0 && a >= 0) || (direction > 0 && a <= 0))
+            continue;
+        if ((a < 0 ? -a : a) < minAmount)
+            continue;
+        [indexes addIndex:i];
+    }
+    return indexes;
+}
+
+@end
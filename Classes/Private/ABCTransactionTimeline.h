@@ -0,0 +1,26 @@
+//
+// ABCTransactionTimeline.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class ABCTimelineFilter;
+
+//
+// Merged, newest first view of the transactions of a set of wallets. The first build
+// k-way merges the already sorted per-wallet arrays. After that, a wallet whose
+// arrayTransactions object has changed is re-merged on its own. Its old entries are
+// dropped and its new list is merged with the rest in one linear pass. Transactions with
+// the same date are ordered by wallet uuid, then txid, whichever way they were merged.
+//
+@interface ABCTransactionTimeline : NSObject
+
+// Brings the timeline up to date with wallets and returns a page of it after filter
+- (NSArray *)transactionsForWallets:(NSArray *)wallets
+                             offset:(NSUInteger)offset
+                              limit:(NSUInteger)limit
+                             filter:(ABCTimelineFilter *)filter;
+
+@end
@@ -0,0 +1,214 @@
+//
+// ABCTransactionTimeline.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCTransactionTimeline.h"
+#import "ABCAccount.h"
+#import "ABCWallet.h"
+#import "ABCTransaction.h"
+#import "ABCMetadata.h"
+
+typedef struct
+{
+    NSUInteger      list;       // index into the lists being merged
+    NSUInteger      next;       // cursor into that list
+    NSTimeInterval  time;       // date of the transaction at the cursor
+    __unsafe_unretained ABCTransaction *tx;  // transaction at the cursor, held by its list
+} tTimelineCursor;
+
+@interface ABCTransactionTimeline ()
+{
+    NSArray                 *merged;
+    NSMutableDictionary     *mergedLists;   // wallet uuid -> arrayTransactions that is in merged
+}
+
+@end
+
+@implementation ABCTransactionTimeline
+
+- (id)init
+{
+    self = [super init];
+    if (self)
+    {
+        merged = [[NSArray alloc] init];
+        mergedLists = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+}
+
+//
+// YES if cursor a should come out of the heap before b: newer first, then by wallet uuid,
+// then by txid. Ties are broken on the transactions themselves rather than on which list
+// they came from, so the incremental merge, which merges the kept part of the previous
+// result with the changed wallets, orders ties exactly as a full merge would.
+//
+static BOOL cursorBefore(tTimelineCursor *a, tTimelineCursor *b)
+{
+    if (a->time != b->time)
+        return a->time > b->time;
+    NSComparisonResult order = [a->tx.wallet.uuid compare:b->tx.wallet.uuid];
+    if (order == NSOrderedSame)
+        order = [a->tx.txid compare:b->tx.txid];
+    if (order != NSOrderedSame)
+        return order == NSOrderedAscending;
+    return a->list < b->list;
+}
+
+static void setCursor(tTimelineCursor *cursor, NSArray *list)
+{
+    cursor->tx = list[cursor->next];
+    cursor->time = [cursor->tx.date timeIntervalSince1970];
+}
+
+static void siftDown(tTimelineCursor *heap, NSUInteger count, NSUInteger i)
+{
+    while (YES)
+    {
+        NSUInteger best = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < count && cursorBefore(&heap[l], &heap[best])) best = l;
+        if (r < count && cursorBefore(&heap[r], &heap[best])) best = r;
+        if (best == i) return;
+        tTimelineCursor tmp = heap[i];
+        heap[i] = heap[best];
+        heap[best] = tmp;
+        i = best;
+    }
+}
+
+// K-way merge of newest first arrays into one newest first array
+static NSArray *mergeLists(NSArray *lists)
+{
+    NSUInteger total = 0, count = 0;
+    tTimelineCursor *heap = calloc([lists count] ? [lists count] : 1, sizeof(tTimelineCursor));
+    for (NSUInteger i = 0; i < [lists count]; i++)
+    {
+        NSArray *list = lists[i];
+        total += [list count];
+        if (![list count]) continue;
+        heap[count].list = i;
+        heap[count].next = 0;
+        setCursor(&heap[count], list);
+        count++;
+    }
+    for (NSUInteger i = count / 2; i-- > 0;)
+        siftDown(heap, count, i);
+    
+    NSMutableArray *result = [[NSMutableArray alloc] initWithCapacity:total];
+    while (count)
+    {
+        NSArray *list = lists[heap[0].list];
+        [result addObject:heap[0].tx];
+        if (++heap[0].next < [list count])
+        {
+            setCursor(&heap[0], list);
+        }
+        else
+        {
+            heap[0] = heap[--count];
+        }
+        siftDown(heap, count, 0);
+    }
+    free(heap);
+    return result;
+}
+
+- (void)updateWithWallets:(NSArray *)wallets
+{
+    NSMutableDictionary *current = [[NSMutableDictionary alloc] initWithCapacity:[wallets count]];
+    NSMutableSet *changed = [[NSMutableSet alloc] init];
+    for (ABCWallet *wallet in wallets)
+    {
+        NSArray *list = wallet.arrayTransactions;
+        if (!list) list = @[];
+        current[wallet.uuid] = list;
+        if (mergedLists[wallet.uuid] != list)
+            [changed addObject:wallet.uuid];
+    }
+    for (NSString *uuid in mergedLists)
+    {
+        if (!current[uuid])
+            [changed addObject:uuid];
+    }
+    if (![changed count])
+        return;
+    
+    if ([changed count] * 2 > [wallets count] || ![merged count])
+    {
+        // Most wallets changed so merge everything from scratch
+        NSMutableArray *lists = [[NSMutableArray alloc] initWithCapacity:[wallets count]];
+        for (ABCWallet *wallet in wallets)
+            [lists addObject:current[wallet.uuid]];
+        merged = mergeLists(lists);
+    }
+    else
+    {
+        // Drop the changed wallets' old entries, then merge in their new lists
+        NSMutableArray *lists = [[NSMutableArray alloc] initWithCapacity:[changed count] + 1];
+        NSIndexSet *keep = [merged indexesOfObjectsPassingTest:^BOOL(ABCTransaction *t, NSUInteger idx, BOOL *stop) {
+            return ![changed containsObject:t.wallet.uuid];
+        }];
+        [lists addObject:[merged objectsAtIndexes:keep]];
+        for (ABCWallet *wallet in wallets)
+        {
+            if ([changed containsObject:wallet.uuid])
+                [lists addObject:current[wallet.uuid]];
+        }
+        merged = mergeLists(lists);
+    }
+    mergedLists = current;
+}
+
+static BOOL matchesFilter(ABCTransaction *t, ABCTimelineFilter *filter)
+{
+    if (filter.direction == ABCTimelineDirectionIncoming && t.amountSatoshi < 0)
+        return NO;
+    if (filter.direction == ABCTimelineDirectionOutgoing && t.amountSatoshi >= 0)
+        return NO;
+    if ([filter.category length] &&
+        ![t.metaData.category hasPrefix:filter.category])
+        return NO;
+    return YES;
+}
+
+- (NSArray *)transactionsForWallets:(NSArray *)wallets
+                             offset:(NSUInteger)offset
+                              limit:(NSUInteger)limit
+                             filter:(ABCTimelineFilter *)filter
+{
+    @synchronized(self)
+    {
+        [self updateWithWallets:wallets];
+        
+        if (!filter || (filter.direction == ABCTimelineDirectionAll && ![filter.category length]))
+        {
+            if (offset >= [merged count])
+                return [[NSArray alloc] init];
+            NSUInteger count = [merged count] - offset;
+            if (limit && limit < count)
+                count = limit;
+            return [merged subarrayWithRange:NSMakeRange(offset, count)];
+        }
+        
+        NSMutableArray *page = [[NSMutableArray alloc] init];
+        NSUInteger skipped = 0;
+        for (ABCTransaction *t in merged)
+        {
+            if (!matchesFilter(t, filter))
+                continue;
+            if (skipped < offset)
+            {
+                skipped++;
+                continue;
+            }
+            [page addObject:t];
+            if (limit && [page count] >= limit)
+                break;
+        }
+        return page;
+    }
+}
+
+@end
@@ -0,0 +1,43 @@
+//
+// ABCTransactionWriter.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+//
+// Streaming writers for the analytics export formats. Rows are passed in batches,
+// oldest first. Each batch is encoded and written to the stream before returning,
+// so only one batch is held in memory.
+//
+@interface ABCTransactionWriter : NSObject
+
+@property (nonatomic, readonly) NSOutputStream  *stream;
+@property (nonatomic, readonly) NSUInteger      rowsWritten;
+
+- (id)initWithStream:(NSOutputStream *)stream;
+
+// Each return NO if the stream fails
+- (BOOL)writeHeader;
+- (BOOL)writeTransactions:(NSArray *)arrayTransactions;
+- (BOOL)writeFooter;
+
+// Writes len bytes in bounded pieces, retrying partial writes
+- (BOOL)writeBytes:(const void *)bytes length:(NSUInteger)len;
+
+@end
+
+//
+// Newline delimited JSON. One object per transaction with the fields of ABCTransaction,
+// its ABCMetaData and its inputOutputList.
+//
+@interface ABCJSONLinesTransactionWriter : ABCTransactionWriter
+@end
+
+//
+// Compact column oriented binary format. The layout is documented with
+// [ABCWallet exportTransactionsToColumnarStream:start:end:progress:] in ABCWallet.h.
+//
+@interface ABCColumnarTransactionWriter : ABCTransactionWriter
+@end
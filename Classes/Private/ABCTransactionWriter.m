@@ -0,0 +1,160 @@
+//
+// ABCTransactionWriter.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCTransactionWriter.h"
+#import "ABCTransaction.h"
+#import "ABCMetadata.h"
+#import "ABCTxInOut.h"
+#import "NSMutableData+LittleEndian.h"
+#import "NSOutputStream+WriteAll.h"
+
+static const uint32_t columnarVersion = 1;
+
+@interface ABCTransactionWriter ()
+
+@property (nonatomic, readwrite, strong)   NSOutputStream  *stream;
+@property (nonatomic, readwrite)           NSUInteger      rowsWritten;
+
+@end
+
+@implementation ABCTransactionWriter
+
+- (id)initWithStream:(NSOutputStream *)stream
+{
+    self = [super init];
+    if (self)
+    {
+        self.stream = stream;
+        self.rowsWritten = 0;
+    }
+    return self;
+}
+
+- (BOOL)writeBytes:(const void *)bytes length:(NSUInteger)len
+{
+    return [self.stream writeAll:bytes length:len];
+}
+
+- (BOOL)writeHeader
+{
+    return YES;
+}
+
+- (BOOL)writeTransactions:(NSArray *)arrayTransactions
+{
+    return NO;
+}
+
+- (BOOL)writeFooter
+{
+    return YES;
+}
+
+@end
+
+@implementation ABCJSONLinesTransactionWriter
+
+static id jsonString(NSString *s)
+{
+    return s ? s : @"";
+}
+
+- (BOOL)writeTransactions:(NSArray *)arrayTransactions
+{
+    NSMutableData *data = [[NSMutableData alloc] init];
+    NSUInteger rows = 0;
+    for (ABCTransaction *t in arrayTransactions)
+    {
+        NSMutableArray *ios = [[NSMutableArray alloc] initWithCapacity:[t.inputOutputList count]];
+        for (ABCTxInOut *io in t.inputOutputList)
+        {
+            [ios addObject:@{@"address"       : jsonString(io.address),
+                             @"amountSatoshi" : [NSNumber numberWithLongLong:io.amountSatoshi],
+                             @"isInput"       : [NSNumber numberWithBool:io.isInput]}];
+        }
+        NSDictionary *row = @{@"txid"           : jsonString(t.txid),
+                              @"date"           : [NSNumber numberWithLongLong:(int64_t) [t.date timeIntervalSince1970]],
+                              @"height"         : [NSNumber numberWithLong:t.height],
+                              @"amountSatoshi"  : [NSNumber numberWithLongLong:t.amountSatoshi],
+                              @"minerFees"      : [NSNumber numberWithLongLong:t.minerFees],
+                              @"providerFee"    : [NSNumber numberWithLongLong:t.providerFee],
+                              @"isReplaceByFee" : [NSNumber numberWithBool:t.isReplaceByFee],
+                              @"isDoubleSpend"  : [NSNumber numberWithBool:t.isDoubleSpend],
+                              @"payeeName"      : jsonString(t.metaData.payeeName),
+                              @"category"       : jsonString(t.metaData.category),
+                              @"notes"          : jsonString(t.metaData.notes),
+                              @"amountFiat"     : [NSNumber numberWithDouble:t.metaData.amountFiat],
+                              @"bizId"          : [NSNumber numberWithUnsignedInt:t.metaData.bizId],
+                              @"inputOutputList": ios};
+        NSData *json = [NSJSONSerialization dataWithJSONObject:row options:0 error:nil];
+        if (!json)
+        {
+            ABCLog(1, @"Skipping transaction %@ that cannot be encoded as JSON", t.txid);
+            continue;
+        }
+        [data appendData:json];
+        [data appendBytes:"\n" length:1];
+        rows++;
+    }
+    if (![self writeBytes:[data bytes] length:[data length]])
+        return NO;
+    self.rowsWritten += rows;
+    return YES;
+}
+
+@end
+
+@implementation ABCColumnarTransactionWriter
+
+- (BOOL)writeHeader
+{
+    NSMutableData *d = [[NSMutableData alloc] init];
+    [d appendBytes:"ABCC" length:4];
+    [d appendUInt32LE:columnarVersion];
+    return [self writeBytes:[d bytes] length:[d length]];
+}
+
+- (BOOL)writeTransactions:(NSArray *)arrayTransactions
+{
+    if (![arrayTransactions count])
+        return YES;
+    
+    NSMutableData *d = [[NSMutableData alloc] init];
+    [d appendUInt32LE:(uint32_t) [arrayTransactions count]];
+    for (ABCTransaction *t in arrayTransactions) [d appendStringLE:t.txid];
+    for (ABCTransaction *t in arrayTransactions) [d appendInt64LE:(int64_t) [t.date timeIntervalSince1970]];
+    for (ABCTransaction *t in arrayTransactions) [d appendInt64LE:t.height];
+    for (ABCTransaction *t in arrayTransactions) [d appendInt64LE:t.amountSatoshi];
+    for (ABCTransaction *t in arrayTransactions) [d appendInt64LE:t.minerFees];
+    for (ABCTransaction *t in arrayTransactions) [d appendInt64LE:t.providerFee];
+    for (ABCTransaction *t in arrayTransactions) [d appendUInt8:(t.isReplaceByFee ? 1 : 0) | (t.isDoubleSpend ? 2 : 0)];
+    for (ABCTransaction *t in arrayTransactions) [d appendStringLE:t.metaData.payeeName];
+    for (ABCTransaction *t in arrayTransactions) [d appendStringLE:t.metaData.category];
+    for (ABCTransaction *t in arrayTransactions) [d appendStringLE:t.metaData.notes];
+    for (ABCTransaction *t in arrayTransactions) [d appendFloat64LE:t.metaData.amountFiat];
+    for (ABCTransaction *t in arrayTransactions) [d appendUInt32LE:t.metaData.bizId];
+    for (ABCTransaction *t in arrayTransactions) [d appendUInt32LE:(uint32_t) [t.inputOutputList count]];
+    for (ABCTransaction *t in arrayTransactions)
+        for (ABCTxInOut *io in t.inputOutputList) [d appendStringLE:io.address];
+    for (ABCTransaction *t in arrayTransactions)
+        for (ABCTxInOut *io in t.inputOutputList) [d appendInt64LE:io.amountSatoshi];
+    for (ABCTransaction *t in arrayTransactions)
+        for (ABCTxInOut *io in t.inputOutputList) [d appendUInt8:io.isInput ? 1 : 0];
+    
+    if (![self writeBytes:[d bytes] length:[d length]])
+        return NO;
+    self.rowsWritten += [arrayTransactions count];
+    return YES;
+}
+
+- (BOOL)writeFooter
+{
+    NSMutableData *d = [[NSMutableData alloc] init];
+    [d appendUInt32LE:0];
+    return [self writeBytes:[d bytes] length:[d length]];
+}
+
+@end
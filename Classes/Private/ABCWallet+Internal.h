@@ -9,14 +9,21 @@
 #import "ABCContext+Internal.h"
 
 @class ABCAccount;
+@class ABCTransactionStore;
 
 @interface ABCWallet (Internal)
 
 @property                           BOOL                bBlockHeightChanged;
+@property (atomic, strong)          ABCTransactionStore *transactionStore;
 
 - (id)initWithUser:(ABCAccount *) user;
 - (void)handleSweepCallback:(ABCTransaction *)transaction amount:(uint64_t)amount error:(ABCError *)error;
 - (void)loadTransactions;
+- (void)loadTransactionsIncremental;
+- (void)loadTransactionsFromSnapshot;
+- (void)loadTransactionsAsync;
+- (BOOL)evictTransactionsIfIdle:(BOOL)bForce;
+- (void)markTransactionDirty:(NSString *)txid;
 - (void)loadWalletFromCore:(NSString *)uuid;
 - (int)getBlockHeight:(ABCError **)nserror;
 - (int)getTxHeight:(NSString *)txid;
@@ -8,14 +8,57 @@
 
 #import "ABCWallet+Internal.h"
 #import "ABCContext+Internal.h"
+#import "ABCWalletSnapshot.h"
+#import "ABCTransactionStore.h"
+#import "ABCTransactionSearchIndex.h"
+#import "ABCTransactionWriter.h"
+#import "NSOutputStream+WriteAll.h"
+#import "ABCBalanceHistory.h"
 
 
 #define HIDDEN_BITZ_URI_SCHEME                          @"hbits"
+#define TX_END_OF_TIME                                  0x0FFFFFFFFFFFFFFF
 static const int importTimeout                  = 30;
 
+// Incremental loads re-query this many seconds before the newest transaction
+// we have already seen so that transactions stamped in the same window are not missed
+static const int64_t incrementalTxOverlapSeconds = 600;
+
+// Wallets whose transactions have not been read for this long may be evicted
+static const double idleTransactionEvictSeconds = 60;
+
+// First time window queried by getTransactionsBefore:limit:error:. Doubles until
+// the page is full.
+static const int64_t pageInitialWindowSeconds = 60 * 60 * 24 * 30;
+
+// Number of page boundary balances remembered for unloaded paging
+static const NSUInteger maxCachedPageBalances = 64;
+
+// Streaming exports aim to ask the core for about this many transactions at a time,
+// starting with a window of exportInitialWindowSeconds
+static const NSUInteger exportChunkTransactions = 500;
+static const int64_t exportInitialWindowSeconds = 60 * 60 * 24 * 30;
+
+// QBO exports are written and report progress in pieces of this size
+static const NSUInteger exportProgressBytes = 64 * 1024;
+
+// Number of balance history series cached per wallet before the cache is cleared
+static const NSUInteger maxCachedBalanceHistories = 8;
+
 @interface ABCWallet ()
 {
     int                 _blockHeight;
+    int64_t             _lastTxTimeCreation;
+    BOOL                _bTransactionsLoaded;
+    BOOL                _bTransactionsLoading;
+    BOOL                _bSearchIndexPending;
+    NSMutableSet        *_dirtyTxids;
+    CFAbsoluteTime      _lastTransactionsAccess;
+    NSMutableDictionary *_balanceHistories;
+    NSMutableDictionary *_pageBalances;
+    int64_t             _pageBalancesWalletBalance;
+    NSUInteger          _offsetCursorIndex;
+    NSDate              *_offsetCursorDate;
 }
 
 @property (nonatomic, strong)   ABCError                    *abcError;
@@ -25,9 +68,15 @@ static const int importTimeout                  = 30;
 @property (nonatomic, strong)   NSString                    *sweptAddress;
 @property (nonatomic, strong)   NSTimer                     *importCallbackTimer;
 @property                       BOOL                        bBlockHeightChanged;
+@property (atomic, strong)      NSDictionary                *transactionsByTxid;
+@property (atomic, strong)      ABCTransactionStore         *transactionStore;
+@property (atomic, strong)      ABCTransactionSearchIndex   *searchIndex;
 
 
 
+@end
+
+@implementation ABCBalancePoint
 @end
 
 @implementation ABCWallet
@@ -42,6 +91,9 @@ static const int importTimeout                  = 30;
         self.uuid = @"";
         self.name = @"";
         self.arrayTransactions = [[NSArray alloc] init];
+        _dirtyTxids = [[NSMutableSet alloc] init];
+        _balanceHistories = [[NSMutableDictionary alloc] init];
+        _pageBalances = [[NSMutableDictionary alloc] init];
         self.abcError = [[ABCError alloc] init];
         self.account = account;
         self.bBlockHeightChanged = YES;
@@ -55,6 +107,114 @@ static const int importTimeout                  = 30;
 
 }
 
+//
+// Transactions are loaded on first access rather than with the rest of the wallet
+// so that login and refresh cost does not scale with every wallet's history. The
+// load runs on the wallets queue. Until it finishes this returns the current, possibly
+// empty, array. abcAccountWalletChanged: is sent once the transactions are in.
+//
+- (NSArray *)arrayTransactions
+{
+    @synchronized(self)
+    {
+        _lastTransactionsAccess = CFAbsoluteTimeGetCurrent();
+        if (!_bTransactionsLoaded && self.loaded)
+            [self loadTransactionsAsync];
+        return _arrayTransactions;
+    }
+}
+
+- (void)loadTransactionsAsync
+{
+    @synchronized(self)
+    {
+        if (_bTransactionsLoaded || _bTransactionsLoading)
+            return;
+        _bTransactionsLoading = YES;
+    }
+    
+    [self.account postToWalletsQueue:^{
+        [self loadTransactionsFromSnapshot];
+        @synchronized(self)
+        {
+            _bTransactionsLoading = NO;
+        }
+        [self.account notifyWalletChanged:self];
+    }];
+}
+
+//
+// Shows the on-disk snapshot right away and reconciles it against the core in the
+// background. Falls back to a full load from the core if there is no usable snapshot.
+// The reconcile is incremental from the snapshot's newest transaction, just like a
+// refresh. Changes the snapshot cannot see, such as edits synced from another device,
+// arrive with the full reload that follows a data sync that changed the wallet.
+// Runs on the wallets queue. The snapshot is read and decrypted without holding the
+// wallet lock so that readers of arrayTransactions are never held up by it.
+//
+- (void)loadTransactionsFromSnapshot
+{
+    if ([self transactionsLoaded])
+        return;
+    
+    NSArray *snapshot = [ABCWalletSnapshot readTransactionsForWallet:self];
+    if (!snapshot)
+    {
+        [self loadAllTransactions];
+        return;
+    }
+    
+    NSMutableDictionary *transactionsByTxid = [[NSMutableDictionary alloc] initWithCapacity:[snapshot count]];
+    int64_t lastTxTimeCreation = 0;
+    for (ABCTransaction *t in snapshot)
+    {
+        [transactionsByTxid setObject:t forKey:t.txid];
+        int64_t timeCreation = (int64_t) [t.date timeIntervalSince1970];
+        if (timeCreation > lastTxTimeCreation)
+            lastTxTimeCreation = timeCreation;
+    }
+    
+    @synchronized(self)
+    {
+        if (_bTransactionsLoaded)
+            return;
+        _lastTxTimeCreation = lastTxTimeCreation;
+        _bTransactionsLoaded = YES;
+        [self setTransactions:snapshot byTxid:transactionsByTxid];
+    }
+    ABCLog(2, @"Loaded %lu transactions from snapshot %@", (unsigned long)[snapshot count], self.uuid);
+    
+    [self.account postToWalletsQueue:^{
+        [self loadTransactionsIncremental];
+        [self.account refreshWallet:self.uuid];
+    }];
+}
+
+- (BOOL)transactionsLoaded
+{
+    @synchronized(self)
+    {
+        return _bTransactionsLoaded;
+    }
+}
+
+// Drops the transaction array if it has not been read recently. Returns YES if evicted.
+- (BOOL)evictTransactionsIfIdle:(BOOL)bForce
+{
+    @synchronized(self)
+    {
+        if (!_bTransactionsLoaded)
+            return NO;
+        if (!bForce && CFAbsoluteTimeGetCurrent() - _lastTransactionsAccess < idleTransactionEvictSeconds)
+            return NO;
+        
+        _bTransactionsLoaded = NO;
+        _lastTxTimeCreation = 0;
+        [self setTransactions:[[NSArray alloc] init] byTxid:nil];
+        return YES;
+    }
+}
+
 - (ABCError *) renameWallet:(NSString *)newName;
 {
     tABC_Error error;
@@ -63,8 +223,11 @@ static const int importTimeout                  = 30;
                      [self.uuid UTF8String],
                      (char *)[newName UTF8String],
                      &error);
-    [self.account refreshWallets];
-    return [ABCError makeNSError:error];
+    [self.account refreshWallet:self.uuid];
+    ABCError *nserror = [ABCError makeNSError:error];
+    if (!nserror)
+        [self.account requestWalletDataSync:self.uuid];
+    return nserror;
 }
 
 - (ABCError *)removeWallet
@@ -90,6 +253,7 @@ static const int importTimeout                  = 30;
     tABC_Error error;
     
     ABC_WalletRemove([self.account.name UTF8String], [self.uuid UTF8String], &error);
+    [ABCWalletSnapshot removeSnapshotForWallet:self];
     
     [self.account refreshWallets];
     return [ABCError makeNSError:error];
@@ -123,6 +287,8 @@ static const int importTimeout                  = 30;
          
          ABC_WalletRemove([self.account.name UTF8String], [self.uuid UTF8String], &error);
          ABCError *nserror = [ABCError makeNSError:error];
+         if (!nserror)
+             [ABCWalletSnapshot removeSnapshotForWallet:self];
          
          [self.account refreshWallets];
          
@@ -384,6 +550,245 @@ static const int importTimeout                  = 30;
     return nserror;
 }
 
+#pragma mark - Streaming export
+
+static ABCError *exportWriteError(NSOutputStream *stream)
+{
+    tABC_Error error;
+    memset(&error, 0, sizeof(error));
+    error.code = ABC_CC_FileWriteError;
+    NSString *reason = stream.streamError ? [stream.streamError localizedDescription] : @"Export stream write failed";
+    strncpy(error.szDescription, [reason UTF8String], sizeof(error.szDescription) - 1);
+    return [ABCError makeNSError:error];
+}
+
+static void exportTimes(NSDate *start, NSDate *end, int64_t *startTime, int64_t *endTime)
+{
+    *startTime = start ? (int64_t) [start timeIntervalSince1970] : 0;
+    *endTime = end ? (int64_t) [end timeIntervalSince1970] : TX_END_OF_TIME;
+}
+
+//
+// Exports walk [startTime, endTime) oldest first in time windows. The window doubles
+// after a chunk with less than half of exportChunkTransactions and halves after one with
+// more than twice that, so empty years are crossed in a few steps. The chunks are
+// planned from what the core returns, never by loading the wallet's transactions.
+// Time bounds never split transactions with equal timestamps.
+//
+static int64_t exportChunkEnd(int64_t chunkStart, int64_t endTime, int64_t window)
+{
+    return endTime - chunkStart > window ? chunkStart + window : endTime;
+}
+
+static int64_t exportNextWindow(int64_t window, NSUInteger count)
+{
+    if (count < exportChunkTransactions / 2 && window < INT64_MAX / 4)
+        return window * 2;
+    if (count > exportChunkTransactions * 2 && window > 1)
+        return window / 2;
+    return window;
+}
+
+// Fraction of [startTime, endTime) done. An open end counts as now.
+static double exportProgress(int64_t startTime, int64_t endTime, int64_t done)
+{
+    int64_t now = (int64_t) [[NSDate date] timeIntervalSince1970];
+    int64_t last = endTime < now ? endTime : now;
+    if (done >= endTime || last <= startTime)
+        return 1.0;
+    double f = (double) (done - startTime) / (double) (last - startTime);
+    return f < 1.0 ? f : 0.99;
+}
+
+- (ABCError *)exportTransactionsToCSVStream:(NSOutputStream *)stream
+                                      start:(NSDate *)start
+                                        end:(NSDate *)end
+                                   progress:(void (^)(double progress))progress;
+{
+    tABC_Error error;
+    int64_t startTime, endTime;
+    exportTimes(start, end, &startTime, &endTime);
+    
+    if (!stream)
+    {
+        error.code = ABC_CC_NULLPtr;
+        return [ABCError makeNSError:error];
+    }
+    if (stream.streamStatus == NSStreamStatusNotOpen)
+        [stream open];
+    
+    BOOL bWroteHeader = NO;
+    int64_t window = exportInitialWindowSeconds;
+    // 0 asks the core for all times, so a chunk must never start there
+    int64_t chunkStart = MAX(startTime, 1);
+    while (chunkStart < endTime)
+    {
+        int64_t chunkEnd = exportChunkEnd(chunkStart, endTime, window);
+        char *szCsvData = NULL;
+        ABC_CsvExport([self.account.name UTF8String],
+                      [self.account.password UTF8String],
+                      [self.uuid UTF8String],
+                      chunkStart, chunkEnd,
+                      &szCsvData, &error);
+        if (ABC_CC_NoTransaction == error.code)
+        {
+            // An empty chunk is not an error unless the whole range is empty
+            if (szCsvData) free(szCsvData);
+            chunkStart = chunkEnd;
+            window = exportNextWindow(window, 0);
+            if (chunkStart < endTime || bWroteHeader)
+                continue;
+            return [ABCError makeNSError:error];
+        }
+        ABCError *nserror = [ABCError makeNSError:error];
+        if (nserror)
+        {
+            ABCLog(2,@("Error: ABCWallet.exportTransactionsToCSVStream:  %s\n"), error.szDescription);
+            if (szCsvData) free(szCsvData);
+            return nserror;
+        }
+        
+        // Every chunk starts with the header line. Keep only the first one.
+        const char *data = szCsvData ? szCsvData : "";
+        const char *eol = strchr(data, '\n');
+        const char *rows = eol ? eol + 1 : data + strlen(data);
+        NSUInteger count = 0;
+        for (const char *p = rows; (p = strchr(p, '\n')); p++)
+            count++;
+        if (bWroteHeader)
+            data = rows;
+        BOOL bOk = [stream writeAll:data length:strlen(data)];
+        bWroteHeader = YES;
+        if (szCsvData) free(szCsvData);
+        if (!bOk)
+            return exportWriteError(stream);
+        
+        chunkStart = chunkEnd;
+        window = exportNextWindow(window, count);
+        if (progress)
+            progress(exportProgress(startTime, endTime, chunkStart));
+    }
+    return nil;
+}
+
+- (ABCError *)exportTransactionsToQBOStream:(NSOutputStream *)stream
+                                      start:(NSDate *)start
+                                        end:(NSDate *)end
+                                   progress:(void (^)(double progress))progress;
+{
+    char *szQBOData = NULL;
+    tABC_Error error;
+    int64_t startTime, endTime;
+    exportTimes(start, end, &startTime, &endTime);
+    
+    if (!stream)
+    {
+        error.code = ABC_CC_NULLPtr;
+        return [ABCError makeNSError:error];
+    }
+    if (stream.streamStatus == NSStreamStatusNotOpen)
+        [stream open];
+    
+    // QBO is a single document with totals in its header so it cannot be produced in
+    // date chunks. It is still written straight from the core's buffer without the
+    // NSString copies.
+    ABC_QBOExport([self.account.name UTF8String],
+                  [self.account.password UTF8String],
+                  [self.uuid UTF8String],
+                  startTime, endTime, &szQBOData, &error);
+    ABCError *nserror = [ABCError makeNSError:error];
+    if (!nserror && szQBOData)
+    {
+        size_t len = strlen(szQBOData);
+        size_t done = 0;
+        while (done < len)
+        {
+            size_t piece = len - done < exportProgressBytes ? len - done : exportProgressBytes;
+            if (![stream writeAll:szQBOData + done length:piece])
+            {
+                nserror = exportWriteError(stream);
+                break;
+            }
+            done += piece;
+            if (progress)
+                progress((double) done / len);
+        }
+    }
+    
+    if (szQBOData) free(szQBOData);
+    return nserror;
+}
+
+//
+// Feeds [start, end) to writer oldest first, one chunk at a time as produced by
+// coreTransactionsFrom:to:addTo:
+//
+- (ABCError *)exportTransactionsToWriter:(ABCTransactionWriter *)writer
+                                   start:(NSDate *)start
+                                     end:(NSDate *)end
+                                progress:(void (^)(double progress))progress
+{
+    tABC_Error error;
+    int64_t startTime, endTime;
+    exportTimes(start, end, &startTime, &endTime);
+    
+    if (!writer.stream)
+    {
+        error.code = ABC_CC_NULLPtr;
+        return [ABCError makeNSError:error];
+    }
+    if (writer.stream.streamStatus == NSStreamStatusNotOpen)
+        [writer.stream open];
+    
+    if (![writer writeHeader])
+        return exportWriteError(writer.stream);
+    
+    int64_t window = exportInitialWindowSeconds;
+    // 0 asks the core for all times, so a chunk must never start there
+    int64_t chunkStart = MAX(startTime, 1);
+    while (chunkStart < endTime)
+    {
+        int64_t chunkEnd = exportChunkEnd(chunkStart, endTime, window);
+        NSUInteger count;
+        @autoreleasepool
+        {
+            NSMutableArray *chunk = [[NSMutableArray alloc] init];
+            ABCError *nserror = [self coreTransactionsFrom:chunkStart to:chunkEnd addTo:chunk];
+            if (nserror)
+                return nserror;
+            count = [chunk count];
+            if (count && ![writer writeTransactions:[[chunk reverseObjectEnumerator] allObjects]])
+                return exportWriteError(writer.stream);
+        }
+        chunkStart = chunkEnd;
+        window = exportNextWindow(window, count);
+        if (progress)
+            progress(exportProgress(startTime, endTime, chunkStart));
+    }
+    
+    if (![writer writeFooter])
+        return exportWriteError(writer.stream);
+    return nil;
+}
+
+- (ABCError *)exportTransactionsToJSONLinesStream:(NSOutputStream *)stream
+                                            start:(NSDate *)start
+                                              end:(NSDate *)end
+                                         progress:(void (^)(double progress))progress;
+{
+    ABCTransactionWriter *writer = [[ABCJSONLinesTransactionWriter alloc] initWithStream:stream];
+    return [self exportTransactionsToWriter:writer start:start end:end progress:progress];
+}
+
+- (ABCError *)exportTransactionsToColumnarStream:(NSOutputStream *)stream
+                                           start:(NSDate *)start
+                                             end:(NSDate *)end
+                                        progress:(void (^)(double progress))progress;
+{
+    ABCTransactionWriter *writer = [[ABCColumnarTransactionWriter alloc] initWithStream:stream];
+    return [self exportTransactionsToWriter:writer start:start end:end progress:progress];
+}
+
 - (ABCError *)exportWalletPrivateSeed:(NSMutableString *) seed
 {
     tABC_Error error;
@@ -446,6 +851,14 @@ static const int importTimeout                  = 30;
     ABCTransaction *transaction = nil;
     tABC_TxInfo *pTrans = NULL;
     
+    if (!txId)
+        return nil;
+    
+    // Serve from the index built by loadTransactions. Only go to the core on a miss
+    transaction = [self.transactionsByTxid objectForKey:txId];
+    if (transaction)
+        return transaction;
+    
     tABC_CC result = ABC_GetTransaction([self.account.name UTF8String],
                                         [self.account.password UTF8String],
                                         [self.uuid UTF8String], [txId UTF8String],
@@ -465,31 +878,192 @@ static const int importTimeout                  = 30;
 
 - (int64_t)getTotalSentToday
 {
-    int64_t total = 0;
+    return [self getTotalSentInLastDays:1];
+}
+
+//
+// Spending totals come from the column store when the transactions are loaded.
+// Otherwise only the requested window is read from the core, so asking for totals
+// does not load the wallet's whole history.
+//
+- (int64_t)getTotalSentInLastDays:(NSUInteger)days
+{
+    if ([self transactionsLoaded])
+        return [self.transactionStore totalSentInLastDays:days];
     
-    if ([self.arrayTransactions count] == 0)
+    if (days == 0)
         return 0;
-    
-    for (ABCTransaction *t in self.arrayTransactions)
+    NSCalendar *calendar = [NSCalendar currentCalendar];
+    NSDate *today = [calendar startOfDayForDate:[NSDate date]];
+    NSDate *since = [calendar dateByAddingUnit:NSCalendarUnitDay value:-(NSInteger)(days - 1)
+                                        toDate:today options:0];
+    return [self coreTotalSentSince:(int64_t) [since timeIntervalSince1970]];
+}
+
+- (int64_t)getTotalSentInLastHours:(double)hours
+{
+    int64_t since = (int64_t) ([[NSDate date] timeIntervalSince1970] - hours * 60 * 60);
+    if ([self transactionsLoaded])
+        return [self.transactionStore totalSentSince:since];
+    return [self coreTotalSentSince:since];
+}
+
+- (int64_t)coreTotalSentSince:(int64_t)since
+{
+    tABC_Error Error;
+    unsigned int tCount = 0;
+    tABC_TxInfo **aTransactions = NULL;
+    int64_t total = 0;
+    tABC_CC result = ABC_GetTransactions([self.account.name UTF8String],
+                                         [self.account.password UTF8String],
+                                         [self.uuid UTF8String],
+                                         since, TX_END_OF_TIME,
+                                         &aTransactions, &tCount, &Error);
+    if (ABC_CC_Ok == result)
     {
-        if ([[NSCalendar currentCalendar] isDateInToday:t.date])
+        for (unsigned int j = 0; j < tCount; j++)
         {
-            if (t.amountSatoshi < 0)
-            {
-                total += t.amountSatoshi * -1;
-            }
+            int64_t amount = aTransactions[j]->pDetails->amountSatoshi;
+            if (aTransactions[j]->timeCreation >= since && amount < 0)
+                total -= amount;
         }
     }
+    else
+    {
+        ABCLog(2,@("Error: ABCWallet.coreTotalSentSince:  %s\n"), Error.szDescription);
+    }
+    ABC_FreeTransactions(aTransactions, tCount);
     return total;
+}
+
+- (NSArray *)getBalanceHistoryFrom:(NSDate *)start to:(NSDate *)end interval:(NSTimeInterval)interval
+{
+    if (!start || interval < 1)
+        return [[NSArray alloc] init];
+    int64_t startTime = (int64_t) [start timeIntervalSince1970];
+    int64_t endTime = (int64_t) [(end ? end : [NSDate date]) timeIntervalSince1970];
+    if (endTime <= startTime)
+        return [[NSArray alloc] init];
+    int64_t bucketInterval = [ABCBalanceHistory intervalForStart:startTime end:endTime interval:(int64_t) interval];
+    
+    NSString *key = [NSString stringWithFormat:@"%lld:%lld", startTime, bucketInterval];
+    ABCBalanceHistory *history;
+    @synchronized(_balanceHistories)
+    {
+        history = [_balanceHistories objectForKey:key];
+        if (!history)
+        {
+            if ([_balanceHistories count] >= maxCachedBalanceHistories)
+                [_balanceHistories removeAllObjects];
+            history = [[ABCBalanceHistory alloc] initWithStart:startTime interval:bucketInterval];
+            [_balanceHistories setObject:history forKey:key];
+        }
+    }
+    
+    // Starts the load if needed. Until it finishes the history is empty
+    [self arrayTransactions];
+    ABCTransactionStore *store = self.transactionStore;
+    [history updateWithTimestamps:store.timestamps balances:store.balances count:store.count];
+    return [history pointsTo:endTime];
+}
+
+// Installs a new newest first transaction list along with its txid index and column store
+- (void)setTransactions:(NSArray *)arrayTransactions byTxid:(NSDictionary *)transactionsByTxid
+{
+    [self setTransactions:arrayTransactions byTxid:transactionsByTxid unchangedTail:0];
+}
+
+//
+// unchangedTail is the number of transactions at the old end of arrayTransactions that
+// are carried over untouched from the current array. Their store columns and sent
+// totals are reused so an incremental merge only pays for the transactions it changed.
+//
+- (void)setTransactions:(NSArray *)arrayTransactions byTxid:(NSDictionary *)transactionsByTxid
+          unchangedTail:(NSUInteger)unchangedTail
+{
+    self.transactionStore = [[ABCTransactionStore alloc] initWithTransactions:arrayTransactions
+                                                                     previous:self.transactionStore
+                                                                unchangedTail:unchangedTail];
+    self.transactionsByTxid = transactionsByTxid;
+    self.arrayTransactions = arrayTransactions;
+
+    if (![arrayTransactions count])
+        self.searchIndex = nil;
+    else
+        [self scheduleSearchIndexUpdate];
+}
+
+//
+// Builds or updates the search index on the wallets queue so that neither the thread
+// installing transactions nor the one searching pays for indexing. Back to back
+// installs share one update. abcAccountWalletChanged: is sent when a new index is
+// first built so that a search that found nothing while it was building is repeated.
+//
+- (void)scheduleSearchIndexUpdate
+{
+    @synchronized(self)
+    {
+        if (_bSearchIndexPending)
+            return;
+        _bSearchIndexPending = YES;
+    }
     
+    [self.account postToWalletsQueue:^{
+        NSArray *transactions = nil;
+        ABCTransactionSearchIndex *index = nil;
+        @synchronized(self)
+        {
+            _bSearchIndexPending = NO;
+            if (!_bTransactionsLoaded || ![_arrayTransactions count])
+                return;
+            transactions = _arrayTransactions;
+            index = self.searchIndex;
+        }
+        if (index)
+        {
+            [index updateTransactions:transactions];
+            return;
+        }
+        
+        index = [[ABCTransactionSearchIndex alloc] initWithTransactions:transactions];
+        @synchronized(self)
+        {
+            // Evicted while building
+            if (!_bTransactionsLoaded || ![_arrayTransactions count])
+                return;
+            self.searchIndex = index;
+        }
+        [self.account notifyWalletChanged:self];
+    }];
 }
 
+//
+// Transaction loads all run on the wallets queue, so they do not race each other. The
+// wallet lock is only taken to install the result, never across a core call.
+//
 - (void) loadTransactions;
+{
+    @synchronized(self)
+    {
+        _lastTransactionsAccess = CFAbsoluteTimeGetCurrent();
+    }
+    [self loadAllTransactions];
+}
+
+- (void)loadAllTransactions
 {
     tABC_Error Error;
     unsigned int tCount = 0;
     ABCTransaction *transaction;
     tABC_TxInfo **aTransactions = NULL;
+    int64_t lastTxTimeCreation = 0;
+    
+    // Anything marked dirty before this point is covered by the full reload
+    @synchronized(_dirtyTxids)
+    {
+        [_dirtyTxids removeAllObjects];
+    }
+    
     tABC_CC result = ABC_GetTransactions([self.account.name UTF8String],
                                          [self.account.password UTF8String],
                                          [self.uuid UTF8String],
@@ -500,6 +1074,7 @@ static const int importTimeout                  = 30;
     if (ABC_CC_Ok == result)
     {
         NSMutableArray *arrayTransactions = [[NSMutableArray alloc] init];
+        NSMutableDictionary *transactionsByTxid = [[NSMutableDictionary alloc] initWithCapacity:tCount];
         
         for (int j = tCount - 1; j >= 0; --j)
         {
@@ -507,15 +1082,18 @@ static const int importTimeout                  = 30;
             transaction = [[ABCTransaction alloc] initWithWallet:self];
             [self setTransaction:transaction coreTx:pTrans];
             [arrayTransactions addObject:transaction];
+            [transactionsByTxid setObject:transaction forKey:transaction.txid];
+            if (pTrans->timeCreation > lastTxTimeCreation)
+                lastTxTimeCreation = pTrans->timeCreation;
         }
-        SInt64 bal = self.balance;
-        for (int j = 0; j < arrayTransactions.count; j++)
+        [self updateBalances:arrayTransactions fromIndex:0 toIndex:arrayTransactions.count];
+        @synchronized(self)
         {
-            ABCTransaction *t = arrayTransactions[j];
-            t.balance = bal;
-            bal -= t.amountSatoshi;
+            _lastTxTimeCreation = lastTxTimeCreation;
+            _bTransactionsLoaded = YES;
+            [self setTransactions:arrayTransactions byTxid:transactionsByTxid];
         }
-        self.arrayTransactions = arrayTransactions;
+        [ABCWalletSnapshot scheduleWriteTransactions:arrayTransactions forWallet:self];
     }
     else
     {
@@ -524,6 +1102,195 @@ static const int importTimeout                  = 30;
     ABC_FreeTransactions(aTransactions, tCount);
 }
 
+//
+// Merges new and changed transactions into the existing arrayTransactions instead of
+// rebuilding the full history. Only transactions created since the newest one already
+// seen, unconfirmed transactions, and transactions marked with markTransactionDirty
+// are fetched from the core. Does nothing if the transactions have not been loaded yet
+// since the first read of arrayTransactions will load them fresh.
+//
+- (void) loadTransactionsIncremental;
+{
+    if ([self transactionsLoaded])
+        [self mergeNewTransactions];
+}
+
+- (void)mergeNewTransactions
+{
+    tABC_Error Error;
+    unsigned int tCount = 0;
+    tABC_TxInfo **aTransactions = NULL;
+    NSArray *current = _arrayTransactions;
+    NSMutableDictionary *inRange = [[NSMutableDictionary alloc] init];
+    NSMutableDictionary *refetched = [[NSMutableDictionary alloc] init];
+    NSSet *dirtyTxids;
+    int64_t lastTxTimeCreation = _lastTxTimeCreation;
+    int64_t startTime = lastTxTimeCreation - incrementalTxOverlapSeconds;
+    if (startTime < 0)
+        startTime = 0;
+    
+    @synchronized(_dirtyTxids)
+    {
+        dirtyTxids = [_dirtyTxids copy];
+        [_dirtyTxids removeAllObjects];
+    }
+    
+    tABC_CC result = ABC_GetTransactions([self.account.name UTF8String],
+                                         [self.account.password UTF8String],
+                                         [self.uuid UTF8String],
+                                         startTime,
+                                         TX_END_OF_TIME,
+                                         &aTransactions,
+                                         &tCount, &Error);
+    if (ABC_CC_Ok != result)
+    {
+        ABCLog(2,@("Error: ABCContext.loadTransactionsIncremental:  %s\n"), Error.szDescription);
+        ABC_FreeTransactions(aTransactions, tCount);
+        @synchronized(_dirtyTxids)
+        {
+            [_dirtyTxids unionSet:dirtyTxids];
+        }
+        return;
+    }
+    // The core returns oldest first. Walk it backwards, as loadAllTransactions does, so
+    // that transactions with equal timestamps keep the core's order.
+    NSMutableArray *head = [[NSMutableArray alloc] initWithCapacity:tCount];
+    for (int j = tCount - 1; j >= 0; --j)
+    {
+        tABC_TxInfo *pTrans = aTransactions[j];
+        ABCTransaction *transaction = [[ABCTransaction alloc] initWithWallet:self];
+        [self setTransaction:transaction coreTx:pTrans];
+        inRange[transaction.txid] = transaction;
+        [head addObject:transaction];
+        if (pTrans->timeCreation > lastTxTimeCreation)
+            lastTxTimeCreation = pTrans->timeCreation;
+    }
+    ABC_FreeTransactions(aTransactions, tCount);
+    
+    // Unconfirmed transactions can still change state (confirmation, double spend)
+    // and dirty ones have had their details modified
+    NSMutableSet *refetch = [NSMutableSet setWithSet:dirtyTxids];
+    for (ABCTransaction *t in current)
+    {
+        if ([t.date timeIntervalSince1970] < startTime && t.height <= 0)
+            [refetch addObject:t.txid];
+    }
+    for (NSString *txid in refetch)
+    {
+        if (inRange[txid])
+            continue;
+        tABC_TxInfo *pTrans = NULL;
+        result = ABC_GetTransaction([self.account.name UTF8String],
+                                    [self.account.password UTF8String],
+                                    [self.uuid UTF8String], [txid UTF8String],
+                                    &pTrans, &Error);
+        if (ABC_CC_Ok == result)
+        {
+            ABCTransaction *transaction = [[ABCTransaction alloc] initWithWallet:self];
+            [self setTransaction:transaction coreTx:pTrans];
+            refetched[txid] = transaction;
+        }
+        ABC_FreeTransaction(pTrans);
+    }
+    
+    NSUInteger i = 0;
+    while (i < [current count] && [((ABCTransaction *)current[i]).date timeIntervalSince1970] >= startTime)
+        i++;
+    
+    if (i == 0 && [inRange count] == 0 && [refetched count] == 0)
+    {
+        @synchronized(self)
+        {
+            _lastTxTimeCreation = lastTxTimeCreation;
+        }
+        return;
+    }
+    
+    //
+    // The core returned every transaction created since startTime, so the head of the
+    // array is replaced with that set. Older entries keep their position and are only
+    // swapped out if they were refetched. An older transaction that the core has dropped
+    // (ie. a double spend that lost) stays in the array until the next full
+    // loadTransactions, which runs after every data sync that changed the wallet.
+    //
+    NSMutableDictionary *transactionsByTxid = [self.transactionsByTxid mutableCopy];
+    if (!transactionsByTxid)
+        transactionsByTxid = [[NSMutableDictionary alloc] init];
+    for (NSUInteger j = 0; j < i; j++)
+        [transactionsByTxid removeObjectForKey:((ABCTransaction *)current[j]).txid];
+    [transactionsByTxid addEntriesFromDictionary:inRange];
+    
+    NSMutableArray *arrayTransactions = [[NSMutableArray alloc] initWithCapacity:[current count] + [head count]];
+    [arrayTransactions addObjectsFromArray:head];
+    NSUInteger dirtyEnd = [arrayTransactions count];
+    for (; i < [current count]; i++)
+    {
+        ABCTransaction *t = current[i];
+        ABCTransaction *replacement = refetched[t.txid];
+        if (replacement)
+        {
+            [arrayTransactions addObject:replacement];
+            [transactionsByTxid setObject:replacement forKey:t.txid];
+            dirtyEnd = [arrayTransactions count];
+        }
+        else
+        {
+            [arrayTransactions addObject:t];
+        }
+    }
+    
+    // Balances can shift past dirtyEnd, ie. when an older transaction arrives late, so
+    // the store only reuses rows past where updateBalances stopped rewriting them
+    NSUInteger balancesEnd = [self updateBalances:arrayTransactions fromIndex:0 toIndex:dirtyEnd];
+    @synchronized(self)
+    {
+        // Evicted while we were merging
+        if (!_bTransactionsLoaded || _arrayTransactions != current)
+            return;
+        _lastTxTimeCreation = lastTxTimeCreation;
+        [self setTransactions:arrayTransactions byTxid:transactionsByTxid
+                unchangedTail:[arrayTransactions count] - balancesEnd];
+    }
+    [ABCWalletSnapshot scheduleWriteTransactions:arrayTransactions forWallet:self];
+}
+
+- (void)markTransactionDirty:(NSString *)txid;
+{
+    if (!txid)
+        return;
+    @synchronized(_dirtyTxids)
+    {
+        [_dirtyTxids addObject:txid];
+    }
+}
+
+//
+// Recomputes the running balance for arrayTransactions[from..to) which is ordered newest
+// first. Continues past 'to' only if the older entries no longer line up with the
+// recomputed ones. Returns the index where it stopped. Entries from there on kept
+// their balances.
+//
+- (NSUInteger)updateBalances:(NSArray *)arrayTransactions fromIndex:(NSUInteger)from toIndex:(NSUInteger)to
+{
+    SInt64 bal = self.balance;
+    NSUInteger count = [arrayTransactions count];
+    if (from > 0 && from <= count)
+    {
+        ABCTransaction *t = arrayTransactions[from - 1];
+        bal = t.balance - t.amountSatoshi;
+    }
+    NSUInteger j;
+    for (j = from; j < count; j++)
+    {
+        ABCTransaction *t = arrayTransactions[j];
+        if (j >= to && t.balance == bal)
+            break;
+        t.balance = bal;
+        bal -= t.amountSatoshi;
+    }
+    return j;
+}
+
 - (void)setTransaction:(ABCTransaction *) transaction coreTx:(tABC_TxInfo *) pTrans
 {
     transaction.txid = [NSString stringWithUTF8String: pTrans->szID];
@@ -621,6 +1388,337 @@ static const int importTimeout                  = 30;
     return nserror;
 }
 
+//
+// Only searches the index, never the core, so results do not depend on which wallets
+// happen to be loaded and typing does not hit the core once per wallet per keystroke.
+// Unloaded wallets start loading, which reads the snapshot first, and index in the
+// background. abcAccountWalletChanged: is sent once there is something to search.
+//
+- (NSArray *)searchTransactions:(NSString *)term limit:(NSUInteger)limit
+{
+    ABCTransactionSearchIndex *index = nil;
+    @synchronized(self)
+    {
+        _lastTransactionsAccess = CFAbsoluteTimeGetCurrent();
+        if (!_bTransactionsLoaded)
+        {
+            if (self.loaded)
+                [self loadTransactionsAsync];
+            return [[NSArray alloc] init];
+        }
+        index = self.searchIndex;
+    }
+    if (!index)
+        return [[NSArray alloc] init];
+    return [index search:term limit:limit];
+}
+
+#pragma mark - Paged transaction access
+
+//
+// Fetches transactions with timeCreation in [start, end) from the core and appends
+// them to array newest first. Balances are not set.
+//
+- (ABCError *)coreTransactionsFrom:(int64_t)start to:(int64_t)end addTo:(NSMutableArray *)array
+{
+    tABC_Error Error;
+    ABCError *nserror = nil;
+    unsigned int tCount = 0;
+    ABCTransaction *transaction;
+    tABC_TxInfo **aTransactions = NULL;
+    tABC_CC result = ABC_GetTransactions([self.account.name UTF8String],
+                                         [self.account.password UTF8String],
+                                         [self.uuid UTF8String],
+                                         start, end,
+                                         &aTransactions, &tCount, &Error);
+    nserror = [ABCError makeNSError:Error];
+    if (ABC_CC_Ok == result)
+    {
+        for (int j = tCount - 1; j >= 0; --j)
+        {
+            tABC_TxInfo *pTrans = aTransactions[j];
+            if (pTrans->timeCreation < start || pTrans->timeCreation >= end)
+                continue;
+            transaction = [[ABCTransaction alloc] initWithWallet:self];
+            [self setTransaction:transaction coreTx:pTrans];
+            [array addObject:transaction];
+        }
+    }
+    else
+    {
+        ABCLog(2,@("Error: ABCContext.coreTransactionsFrom:  %s\n"), Error.szDescription);
+    }
+    ABC_FreeTransactions(aTransactions, tCount);
+    return nserror;
+}
+
+//
+// Page boundaries reached by the unloaded paging calls. _pageBalances maps a
+// timestamp to the wallet balance before any transaction created at or after it, and
+// _offsetCursorIndex transactions are newer than _offsetCursorDate. Both are dropped
+// when the wallet balance changes, since that is when older history can change.
+// Call with the wallet locked.
+//
+- (void)validatePageCache
+{
+    if (_pageBalancesWalletBalance == self.balance)
+        return;
+    [_pageBalances removeAllObjects];
+    _pageBalancesWalletBalance = self.balance;
+    _offsetCursorIndex = 0;
+    _offsetCursorDate = nil;
+}
+
+//
+// The wallet balance before any transaction created at or after end. Deep pages
+// are normally served from the boundary cached by the previous page, so that only
+// the first page at a new cursor asks the core for everything newer than it.
+//
+- (ABCError *)balance:(int64_t *)balance before:(int64_t)end
+{
+    if (end >= TX_END_OF_TIME)
+    {
+        *balance = self.balance;
+        return nil;
+    }
+    
+    NSNumber *key = [NSNumber numberWithLongLong:end];
+    int64_t walletBalance;
+    @synchronized(self)
+    {
+        [self validatePageCache];
+        walletBalance = _pageBalancesWalletBalance;
+        NSNumber *cached = [_pageBalances objectForKey:key];
+        if (cached)
+        {
+            *balance = [cached longLongValue];
+            return nil;
+        }
+    }
+    
+    int64_t newer = 0;
+    tABC_Error Error;
+    unsigned int tCount = 0;
+    tABC_TxInfo **aTransactions = NULL;
+    tABC_CC result = ABC_GetTransactions([self.account.name UTF8String],
+                                         [self.account.password UTF8String],
+                                         [self.uuid UTF8String],
+                                         end, TX_END_OF_TIME,
+                                         &aTransactions, &tCount, &Error);
+    if (ABC_CC_Ok != result)
+    {
+        ABC_FreeTransactions(aTransactions, tCount);
+        return [ABCError makeNSError:Error];
+    }
+    for (unsigned int j = 0; j < tCount; j++)
+    {
+        if (aTransactions[j]->timeCreation >= end)
+            newer += aTransactions[j]->pDetails->amountSatoshi;
+    }
+    ABC_FreeTransactions(aTransactions, tCount);
+    
+    *balance = walletBalance - newer;
+    [self cacheBalance:*balance before:end walletBalance:walletBalance];
+    return nil;
+}
+
+- (void)cacheBalance:(int64_t)balance before:(int64_t)end walletBalance:(int64_t)walletBalance
+{
+    @synchronized(self)
+    {
+        [self validatePageCache];
+        if (walletBalance != _pageBalancesWalletBalance)
+            return;
+        if ([_pageBalances count] >= maxCachedPageBalances)
+            [_pageBalances removeAllObjects];
+        [_pageBalances setObject:[NSNumber numberWithLongLong:balance]
+                          forKey:[NSNumber numberWithLongLong:end]];
+    }
+}
+
+//
+// Sets the running balance on a newest first page of transactions. The page must
+// hold every transaction created from its oldest timestamp up to end. The balance
+// left after the oldest transaction is cached as the start of the next page.
+//
+- (ABCError *)setBalances:(NSArray *)page newerThan:(int64_t)end
+{
+    int64_t bal;
+    int64_t walletBalance = self.balance;
+    ABCError *error = [self balance:&bal before:end];
+    if (error)
+        return error;
+    if (end >= TX_END_OF_TIME)
+        walletBalance = bal;
+    
+    for (ABCTransaction *t in page)
+    {
+        t.balance = bal;
+        bal -= t.amountSatoshi;
+    }
+    if ([page count])
+    {
+        int64_t oldest = (int64_t) [((ABCTransaction *)[page lastObject]).date timeIntervalSince1970];
+        [self cacheBalance:bal before:oldest walletBalance:walletBalance];
+    }
+    return nil;
+}
+
+// Index of the first transaction in a newest first array dated before date
+static NSUInteger indexBeforeDate(NSArray *array, NSDate *date)
+{
+    NSUInteger lo = 0, hi = [array count];
+    while (lo < hi)
+    {
+        NSUInteger mid = lo + (hi - lo) / 2;
+        if ([((ABCTransaction *)array[mid]).date compare:date] != NSOrderedAscending)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+- (NSArray *)getTransactionsFrom:(NSDate *)start to:(NSDate *)end error:(ABCError **)nserror
+{
+    ABCError *error = nil;
+    NSArray *page = nil;
+    
+    @synchronized(self)
+    {
+        if (_bTransactionsLoaded)
+        {
+            NSArray *array = _arrayTransactions;
+            NSUInteger first = end ? indexBeforeDate(array, end) : 0;
+            NSUInteger last = start ? indexBeforeDate(array, start) : [array count];
+            if (last < first) last = first;
+            page = [array subarrayWithRange:NSMakeRange(first, last - first)];
+        }
+    }
+    
+    if (!page)
+    {
+        int64_t startTime = start ? (int64_t) [start timeIntervalSince1970] : 0;
+        int64_t endTime = end ? (int64_t) ceil([end timeIntervalSince1970]) : TX_END_OF_TIME;
+        NSMutableArray *array = [[NSMutableArray alloc] init];
+        error = [self coreTransactionsFrom:startTime to:endTime addTo:array];
+        if (!error)
+            error = [self setBalances:array newerThan:endTime];
+        page = error ? nil : array;
+    }
+    
+    if (nserror) *nserror = error;
+    return page;
+}
+
+- (NSArray *)getTransactionsBefore:(NSDate *)before limit:(NSUInteger)limit error:(ABCError **)nserror
+{
+    ABCError *error = nil;
+    NSArray *page = nil;
+    
+    if (limit == 0)
+    {
+        if (nserror) *nserror = nil;
+        return [[NSArray alloc] init];
+    }
+    
+    @synchronized(self)
+    {
+        if (_bTransactionsLoaded)
+        {
+            NSArray *array = _arrayTransactions;
+            NSUInteger first = before ? indexBeforeDate(array, before) : 0;
+            NSUInteger last = MIN(first + limit, [array count]);
+            // Do not split transactions sharing a timestamp across pages
+            while (last > first && last < [array count] &&
+                   [((ABCTransaction *)array[last]).date isEqualToDate:((ABCTransaction *)array[last - 1]).date])
+                last++;
+            page = [array subarrayWithRange:NSMakeRange(first, last - first)];
+        }
+    }
+    
+    if (!page)
+    {
+        int64_t endTime = before ? (int64_t) ceil([before timeIntervalSince1970]) : TX_END_OF_TIME;
+        int64_t windowEnd = before ? endTime : (int64_t) [[NSDate date] timeIntervalSince1970] + 1;
+        int64_t window = pageInitialWindowSeconds;
+        NSMutableArray *array = [[NSMutableArray alloc] init];
+        
+        // Anything stamped in the future goes on the first page
+        if (!before)
+            error = [self coreTransactionsFrom:windowEnd to:TX_END_OF_TIME addTo:array];
+        
+        while (!error && [array count] < limit && windowEnd > 0)
+        {
+            int64_t windowStart = MAX(windowEnd - window, 0);
+            error = [self coreTransactionsFrom:windowStart to:windowEnd addTo:array];
+            windowEnd = windowStart;
+            window *= 2;
+        }
+        
+        if (!error)
+        {
+            NSUInteger last = MIN(limit, [array count]);
+            while (last > 0 && last < [array count] &&
+                   [((ABCTransaction *)array[last]).date isEqualToDate:((ABCTransaction *)array[last - 1]).date])
+                last++;
+            [array removeObjectsInRange:NSMakeRange(last, [array count] - last)];
+            error = [self setBalances:array newerThan:endTime];
+        }
+        page = error ? nil : array;
+    }
+    
+    if (nserror) *nserror = error;
+    return page;
+}
+
+- (NSArray *)getTransactionsOffset:(NSUInteger)offset limit:(NSUInteger)limit error:(ABCError **)nserror
+{
+    NSArray *array = nil;
+    @synchronized(self)
+    {
+        if (_bTransactionsLoaded)
+        {
+            if (nserror) *nserror = nil;
+            array = _arrayTransactions;
+            if (offset >= [array count])
+                return [[NSArray alloc] init];
+            return [array subarrayWithRange:NSMakeRange(offset, MIN(limit, [array count] - offset))];
+        }
+    }
+    
+    // Resume from the page boundary left by the previous call, so that paging
+    // forward through the offsets fetches only the new page from the core
+    NSDate *before = nil;
+    NSUInteger skipped = 0;
+    @synchronized(self)
+    {
+        [self validatePageCache];
+        if (_offsetCursorDate && _offsetCursorIndex <= offset)
+        {
+            before = _offsetCursorDate;
+            skipped = _offsetCursorIndex;
+        }
+    }
+    
+    array = [self getTransactionsBefore:before limit:offset - skipped + limit error:nserror];
+    if (!array)
+        return nil;
+    if ([array count])
+    {
+        // getTransactionsBefore never splits a timestamp, so the end of the page is a boundary
+        @synchronized(self)
+        {
+            _offsetCursorIndex = skipped + [array count];
+            _offsetCursorDate = ((ABCTransaction *)[array lastObject]).date;
+        }
+    }
+    offset -= skipped;
+    if (offset >= [array count])
+        return [[NSArray alloc] init];
+    return [array subarrayWithRange:NSMakeRange(offset, MIN(limit, [array count] - offset))];
+}
+
 - (void)loadWalletFromCore:(NSString *)uuid;
 {
     tABC_Error error;
@@ -744,7 +1842,7 @@ static const int importTimeout                  = 30;
             self.currency.code,
             self.archived,
             self.balance,
-            self.arrayTransactions
+            _arrayTransactions
             ]);
 }
 
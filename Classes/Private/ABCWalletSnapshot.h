@@ -0,0 +1,29 @@
+//
+// ABCWalletSnapshot.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class ABCWallet;
+
+//
+// Encrypted on-disk copy of a wallet's decoded transaction list. It is written after
+// the transactions are loaded from the core and read back at the next login so history
+// can be shown before the core has been queried. The file is versioned and
+// authenticated. Any mismatch, whether version, key or corruption, simply reads back
+// as nil.
+//
+@interface ABCWalletSnapshot : NSObject
+
+// Returns the transactions, newest first with balances set, or nil if there is no usable snapshot
++ (NSArray *)readTransactionsForWallet:(ABCWallet *)wallet;
++ (BOOL)writeTransactions:(NSArray *)arrayTransactions forWallet:(ABCWallet *)wallet;
+
+// Writes on a background serial queue. Writes scheduled close together are coalesced
++ (void)scheduleWriteTransactions:(NSArray *)arrayTransactions forWallet:(ABCWallet *)wallet;
+// Deletes the snapshot of a removed wallet and ignores any later writes for it
++ (void)removeSnapshotForWallet:(ABCWallet *)wallet;
+
+@end
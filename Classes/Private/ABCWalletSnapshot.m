@@ -0,0 +1,367 @@
+//
+// ABCWalletSnapshot.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCWalletSnapshot.h"
+#import "ABCWallet+Internal.h"
+#import "ABCContext+Internal.h"
+#import "NSMutableData+LittleEndian.h"
+#import <CommonCrypto/CommonCrypto.h>
+#import <Security/Security.h>
+
+//
+// File layout:
+//   "ABCS" | u32 version | 16 byte IV | AES-256-CBC ciphertext | HMAC-SHA256
+// The HMAC covers everything before it. Both keys are derived from the account's
+// login key and the wallet UUID. All values are little endian.
+//
+// Version 2 writes doubles little endian like everything else
+static const uint32_t snapshotVersion           = 2;
+static const char     snapshotMagic[4]          = { 'A', 'B', 'C', 'S' };
+static const size_t   snapshotHeaderSize        = 4 + 4 + kCCBlockSizeAES128;
+static NSString      *snapshotDirectory         = @"Snapshots";
+
+// Writes scheduled within this many seconds of each other are coalesced into one
+static const double   snapshotWriteDelaySeconds = 5;
+
+#pragma mark - Decoding helpers
+
+typedef struct
+{
+    const uint8_t   *p;
+    size_t          left;
+    BOOL            ok;
+} tReader;
+
+static const uint8_t *readBytes(tReader *r, size_t len)
+{
+    if (!r->ok || r->left < len)
+    {
+        r->ok = NO;
+        return NULL;
+    }
+    const uint8_t *p = r->p;
+    r->p += len;
+    r->left -= len;
+    return p;
+}
+
+static uint8_t readU8(tReader *r)
+{
+    const uint8_t *p = readBytes(r, 1);
+    return p ? *p : 0;
+}
+
+static uint32_t readU32(tReader *r)
+{
+    uint32_t v = 0;
+    const uint8_t *p = readBytes(r, sizeof(v));
+    if (p) memcpy(&v, p, sizeof(v));
+    return CFSwapInt32LittleToHost(v);
+}
+
+static int64_t readI64(tReader *r)
+{
+    uint64_t v = 0;
+    const uint8_t *p = readBytes(r, sizeof(v));
+    if (p) memcpy(&v, p, sizeof(v));
+    return (int64_t) CFSwapInt64LittleToHost(v);
+}
+
+static double readDouble(tReader *r)
+{
+    uint64_t u = (uint64_t) readI64(r);
+    double v;
+    memcpy(&v, &u, sizeof(v));
+    return v;
+}
+
+static NSString *readString(tReader *r)
+{
+    uint32_t len = readU32(r);
+    const uint8_t *p = readBytes(r, len);
+    if (!p) return nil;
+    NSString *s = [[NSString alloc] initWithBytes:p length:len encoding:NSUTF8StringEncoding];
+    if (!s) r->ok = NO;
+    return s;
+}
+
+@implementation ABCWalletSnapshot
+
+#pragma mark - Keys and paths
+
++ (NSString *)pathForWallet:(ABCWallet *)wallet
+{
+    NSString *root = wallet.account.abc.rootDirectory;
+    if (!root || ![wallet.uuid length]) return nil;
+    NSString *dir = [root stringByAppendingPathComponent:snapshotDirectory];
+    return [dir stringByAppendingPathComponent:[wallet.uuid stringByAppendingPathExtension:@"snap"]];
+}
+
++ (NSData *)keyForWallet:(ABCWallet *)wallet purpose:(NSString *)purpose
+{
+    NSString *loginKey = wallet.account.loginKey;
+    if (![loginKey length]) return nil;
+    
+    NSData *secret = [loginKey dataUsingEncoding:NSUTF8StringEncoding];
+    NSData *label = [[NSString stringWithFormat:@"ABCWalletSnapshot.%@:%@", purpose, wallet.uuid]
+                     dataUsingEncoding:NSUTF8StringEncoding];
+    NSMutableData *key = [NSMutableData dataWithLength:CC_SHA256_DIGEST_LENGTH];
+    CCHmac(kCCHmacAlgSHA256, [secret bytes], [secret length], [label bytes], [label length], [key mutableBytes]);
+    return key;
+}
+
+#pragma mark - Serialization
+
++ (NSData *)encodeTransactions:(NSArray *)arrayTransactions
+{
+    NSMutableData *data = [[NSMutableData alloc] initWithCapacity:[arrayTransactions count] * 256];
+    [data appendUInt32LE:(uint32_t) [arrayTransactions count]];
+    for (ABCTransaction *t in arrayTransactions)
+    {
+        [data appendStringLE:t.txid];
+        [data appendFloat64LE:[t.date timeIntervalSince1970]];
+        [data appendInt64LE:t.amountSatoshi];
+        [data appendInt64LE:t.providerFee];
+        [data appendInt64LE:t.minerFees];
+        [data appendInt64LE:t.balance];
+        [data appendInt64LE:t.height];
+        [data appendUInt8:(t.isDoubleSpend ? 1 : 0) | (t.isReplaceByFee ? 2 : 0)];
+        [data appendStringLE:t.metaData.payeeName];
+        [data appendStringLE:t.metaData.category];
+        [data appendStringLE:t.metaData.notes];
+        [data appendUInt32LE:t.metaData.bizId];
+        [data appendFloat64LE:t.metaData.amountFiat];
+        [data appendUInt32LE:(uint32_t) [t.inputOutputList count]];
+        for (ABCTxInOut *io in t.inputOutputList)
+        {
+            [data appendStringLE:io.address];
+            [data appendUInt8:io.isInput ? 1 : 0];
+            [data appendInt64LE:io.amountSatoshi];
+        }
+    }
+    return data;
+}
+
++ (NSArray *)decodeTransactions:(NSData *)data wallet:(ABCWallet *)wallet
+{
+    tReader r = { [data bytes], [data length], YES };
+    uint32_t count = readU32(&r);
+    // Every record is at least 60 bytes so reject counts the payload cannot hold
+    if (!r.ok || count > r.left / 60) return nil;
+    
+    NSMutableArray *array = [[NSMutableArray alloc] initWithCapacity:count];
+    for (uint32_t i = 0; i < count && r.ok; i++)
+    {
+        ABCTransaction *t = [[ABCTransaction alloc] initWithWallet:wallet];
+        t.txid = readString(&r);
+        t.date = [NSDate dateWithTimeIntervalSince1970:readDouble(&r)];
+        t.amountSatoshi = readI64(&r);
+        t.providerFee = readI64(&r);
+        t.minerFees = readI64(&r);
+        t.balance = readI64(&r);
+        t.height = (long) readI64(&r);
+        uint8_t flags = readU8(&r);
+        t.isDoubleSpend = (flags & 1) ? YES : NO;
+        t.isReplaceByFee = (flags & 2) ? YES : NO;
+        t.metaData.payeeName = readString(&r);
+        t.metaData.category = readString(&r);
+        t.metaData.notes = readString(&r);
+        t.metaData.bizId = readU32(&r);
+        t.metaData.amountFiat = readDouble(&r);
+        
+        uint32_t ioCount = readU32(&r);
+        if (!r.ok || ioCount > r.left / 13) return nil;
+        NSMutableArray *outputs = [[NSMutableArray alloc] initWithCapacity:ioCount];
+        for (uint32_t j = 0; j < ioCount && r.ok; j++)
+        {
+            ABCTxInOut *io = [[ABCTxInOut alloc] init];
+            io.address = readString(&r);
+            io.isInput = readU8(&r) ? YES : NO;
+            io.amountSatoshi = readI64(&r);
+            [outputs addObject:io];
+        }
+        t.inputOutputList = outputs;
+        [array addObject:t];
+    }
+    return (r.ok && r.left == 0) ? array : nil;
+}
+
+#pragma mark - Public
+
++ (BOOL)writeTransactions:(NSArray *)arrayTransactions forWallet:(ABCWallet *)wallet
+{
+    NSString *path = [self pathForWallet:wallet];
+    NSData *encKey = [self keyForWallet:wallet purpose:@"enc"];
+    NSData *macKey = [self keyForWallet:wallet purpose:@"mac"];
+    if (!path || !encKey || !macKey) return NO;
+    return [self writeTransactions:arrayTransactions toPath:path encKey:encKey macKey:macKey uuid:wallet.uuid];
+}
+
++ (BOOL)writeTransactions:(NSArray *)arrayTransactions toPath:(NSString *)path
+                   encKey:(NSData *)encKey macKey:(NSData *)macKey uuid:(NSString *)uuid
+{
+    NSData *plain = [self encodeTransactions:arrayTransactions];
+    
+    NSMutableData *file = [[NSMutableData alloc] initWithCapacity:snapshotHeaderSize + [plain length] + kCCBlockSizeAES128 + CC_SHA256_DIGEST_LENGTH];
+    [file appendBytes:snapshotMagic length:sizeof(snapshotMagic)];
+    [file appendUInt32LE:snapshotVersion];
+    
+    uint8_t iv[kCCBlockSizeAES128];
+    if (SecRandomCopyBytes(kSecRandomDefault, sizeof(iv), iv) != 0) return NO;
+    [file appendBytes:iv length:sizeof(iv)];
+    
+    size_t cipherLen = 0;
+    [file increaseLengthBy:[plain length] + kCCBlockSizeAES128];
+    CCCryptorStatus status = CCCrypt(kCCEncrypt, kCCAlgorithmAES128, kCCOptionPKCS7Padding,
+                                     [encKey bytes], kCCKeySizeAES256, iv,
+                                     [plain bytes], [plain length],
+                                     (uint8_t *)[file mutableBytes] + snapshotHeaderSize,
+                                     [plain length] + kCCBlockSizeAES128, &cipherLen);
+    if (status != kCCSuccess) return NO;
+    [file setLength:snapshotHeaderSize + cipherLen];
+    
+    uint8_t mac[CC_SHA256_DIGEST_LENGTH];
+    CCHmac(kCCHmacAlgSHA256, [macKey bytes], [macKey length], [file bytes], [file length], mac);
+    [file appendBytes:mac length:sizeof(mac)];
+    
+    NSError *error = nil;
+    [[NSFileManager defaultManager] createDirectoryAtPath:[path stringByDeletingLastPathComponent]
+                              withIntermediateDirectories:YES attributes:nil error:nil];
+    NSDataWritingOptions options = NSDataWritingAtomic;
+#if TARGET_OS_IPHONE
+    options |= NSDataWritingFileProtectionCompleteUntilFirstUserAuthentication;
+#endif
+    if (![file writeToFile:path options:options error:&error])
+    {
+        ABCLog(1, @"Failed to write snapshot %@: %@", uuid, error);
+        return NO;
+    }
+    return YES;
+}
+
++ (NSArray *)readTransactionsForWallet:(ABCWallet *)wallet
+{
+    NSString *path = [self pathForWallet:wallet];
+    NSData *encKey = [self keyForWallet:wallet purpose:@"enc"];
+    NSData *macKey = [self keyForWallet:wallet purpose:@"mac"];
+    if (!path || !encKey || !macKey) return nil;
+    
+    // Mapped so the ciphertext is paged in by the MAC and decrypt passes
+    // rather than copied into memory first
+    NSData *file = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if ([file length] < snapshotHeaderSize + kCCBlockSizeAES128 + CC_SHA256_DIGEST_LENGTH)
+        return nil;
+    
+    const uint8_t *bytes = [file bytes];
+    uint32_t version = 0;
+    memcpy(&version, bytes + sizeof(snapshotMagic), sizeof(version));
+    if (memcmp(bytes, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+        CFSwapInt32LittleToHost(version) != snapshotVersion)
+        return nil;
+    
+    size_t bodyLen = [file length] - CC_SHA256_DIGEST_LENGTH;
+    uint8_t mac[CC_SHA256_DIGEST_LENGTH];
+    CCHmac(kCCHmacAlgSHA256, [macKey bytes], [macKey length], bytes, bodyLen, mac);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < sizeof(mac); i++)
+        diff |= mac[i] ^ bytes[bodyLen + i];
+    if (diff != 0)
+    {
+        ABCLog(1, @"Discarding snapshot %@: authentication failed", wallet.uuid);
+        return nil;
+    }
+    
+    size_t cipherLen = bodyLen - snapshotHeaderSize;
+    NSMutableData *plain = [NSMutableData dataWithLength:cipherLen];
+    size_t plainLen = 0;
+    CCCryptorStatus status = CCCrypt(kCCDecrypt, kCCAlgorithmAES128, kCCOptionPKCS7Padding,
+                                     [encKey bytes], kCCKeySizeAES256,
+                                     bytes + sizeof(snapshotMagic) + sizeof(version),
+                                     bytes + snapshotHeaderSize, cipherLen,
+                                     [plain mutableBytes], cipherLen, &plainLen);
+    if (status != kCCSuccess) return nil;
+    [plain setLength:plainLen];
+    
+    NSArray *array = [self decodeTransactions:plain wallet:wallet];
+    [plain resetBytesInRange:NSMakeRange(0, [plain length])];
+    return array;
+}
+
+#pragma mark - Write queue
+
+static dispatch_queue_t     writeQueue      = nil;
+static NSMutableDictionary  *pendingWrites  = nil;     // path -> newest arrayTransactions not yet written
+static NSMutableSet         *removedPaths   = nil;     // snapshots of deleted wallets
+
++ (void)initWriteQueue
+{
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        writeQueue = dispatch_queue_create("ABCWalletSnapshot.write", DISPATCH_QUEUE_SERIAL);
+        dispatch_set_target_queue(writeQueue, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_BACKGROUND, 0));
+        pendingWrites = [[NSMutableDictionary alloc] init];
+        removedPaths = [[NSMutableSet alloc] init];
+    });
+}
+
+//
+// Every write re-encrypts the whole history, so a burst of incremental refreshes only
+// writes the last array it produced. The keys are taken now so that a write which
+// lands after logout still succeeds.
+//
++ (void)scheduleWriteTransactions:(NSArray *)arrayTransactions forWallet:(ABCWallet *)wallet
+{
+    NSString *path = [self pathForWallet:wallet];
+    NSData *encKey = [self keyForWallet:wallet purpose:@"enc"];
+    NSData *macKey = [self keyForWallet:wallet purpose:@"mac"];
+    NSString *uuid = wallet.uuid;
+    if (!path || !encKey || !macKey) return;
+    
+    [self initWriteQueue];
+    @synchronized(pendingWrites)
+    {
+        if ([removedPaths containsObject:path])
+            return;
+        BOOL bScheduled = [pendingWrites objectForKey:path] != nil;
+        [pendingWrites setObject:arrayTransactions forKey:path];
+        if (bScheduled)
+            return;
+    }
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (snapshotWriteDelaySeconds * NSEC_PER_SEC)), writeQueue, ^{
+        NSArray *latest;
+        @synchronized(pendingWrites)
+        {
+            latest = [pendingWrites objectForKey:path];
+            [pendingWrites removeObjectForKey:path];
+        }
+        if (latest)
+            [self writeTransactions:latest toPath:path encKey:encKey macKey:macKey uuid:uuid];
+    });
+}
+
+//
+// Drops any pending write and deletes the file once a write already in progress is
+// done. Later writes for the wallet are ignored, so a load that was still running
+// when the wallet was deleted cannot bring the snapshot back.
+//
++ (void)removeSnapshotForWallet:(ABCWallet *)wallet
+{
+    NSString *path = [self pathForWallet:wallet];
+    if (!path) return;
+    
+    [self initWriteQueue];
+    @synchronized(pendingWrites)
+    {
+        [removedPaths addObject:path];
+        [pendingWrites removeObjectForKey:path];
+    }
+    dispatch_async(writeQueue, ^{
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    });
+}
+
+@end
@@ -0,0 +1,37 @@
+//
+// ABCWatcher.h
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+//
+// Hosts a single wallet's ABC_WatcherLoop. The loop blocks until ABC_WatcherStop is
+// called, so it runs on its own NSThread rather than a GCD backed NSOperationQueue.
+// This keeps long lived watchers from pinning threads out of the shared GCD pool.
+// Also tracks how long the wallet's events take to reach the delegate.
+//
+// Limitation: the core only offers the blocking ABC_WatcherLoop and no way to poll or
+// wait on several watchers at once, so watchers cannot be multiplexed onto a shared
+// pool. Each wallet still costs one thread. The thread keeps the default stack size
+// since the loop runs libbitcoin networking and the wallet callbacks on it.
+//
+@interface ABCWatcher : NSObject
+
+@property (nonatomic, copy, readonly)   NSString            *uuid;
+@property (atomic, readonly)            unsigned long       eventCount;
+@property (atomic, readonly)            NSTimeInterval      lastEventLatency;
+@property (atomic, readonly)            NSTimeInterval      maxEventLatency;
+@property (atomic, readonly)            NSTimeInterval      averageEventLatency;
+
+- (id)initWithUUID:(NSString *)uuid;
+
+// Runs loop on the watcher's thread. May only be called once.
+- (void)start:(void(^)(void))loop;
+
+// Blocks until the loop returns. Pass a negative timeout to wait forever.
+- (BOOL)waitUntilFinished:(NSTimeInterval)timeout;
+- (void)recordEventLatency:(NSTimeInterval)latency;
+
+@end
@@ -0,0 +1,76 @@
+//
+// ABCWatcher.m
+//
+// Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "ABCWatcher.h"
+
+@interface ABCWatcher ()
+{
+    dispatch_group_t    group;
+    NSTimeInterval      totalEventLatency;
+}
+
+@property (nonatomic, copy)     NSString            *uuid;
+@property (atomic)              unsigned long       eventCount;
+@property (atomic)              NSTimeInterval      lastEventLatency;
+@property (atomic)              NSTimeInterval      maxEventLatency;
+@property (atomic)              NSTimeInterval      averageEventLatency;
+@property (atomic, strong)      NSThread            *thread;
+
+@end
+
+@implementation ABCWatcher
+
+- (id)initWithUUID:(NSString *)uuid
+{
+    self = [super init];
+    if (self)
+    {
+        self.uuid = uuid;
+        group = dispatch_group_create();
+    }
+    return self;
+}
+
+- (void)start:(void(^)(void))loop
+{
+    if (self.thread || !loop) return;
+    
+    dispatch_group_enter(group);
+    self.thread = [[NSThread alloc] initWithTarget:self selector:@selector(run:) object:[loop copy]];
+    self.thread.name = [NSString stringWithFormat:@"Watcher %@", self.uuid];
+    [self.thread start];
+}
+
+- (void)run:(void(^)(void))loop
+{
+    @autoreleasepool
+    {
+        loop();
+    }
+    dispatch_group_leave(group);
+}
+
+- (BOOL)waitUntilFinished:(NSTimeInterval)timeout
+{
+    dispatch_time_t when = timeout < 0 ? DISPATCH_TIME_FOREVER :
+        dispatch_time(DISPATCH_TIME_NOW, (int64_t)(timeout * NSEC_PER_SEC));
+    return dispatch_group_wait(group, when) == 0;
+}
+
+- (void)recordEventLatency:(NSTimeInterval)latency
+{
+    @synchronized(self)
+    {
+        self.eventCount++;
+        totalEventLatency += latency;
+        self.lastEventLatency = latency;
+        if (latency > self.maxEventLatency)
+            self.maxEventLatency = latency;
+        self.averageEventLatency = totalEventLatency / self.eventCount;
+    }
+}
+
+@end
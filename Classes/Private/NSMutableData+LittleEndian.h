@@ -0,0 +1,24 @@
+//
+//  NSMutableData+LittleEndian.h
+//  Airbitz
+//
+//  Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+//
+// Appends fixed width values in little endian byte order. Shared by the wallet
+// snapshot and the columnar export so both encode values the same way.
+//
+@interface NSMutableData (LittleEndian)
+
+- (void)appendUInt8:(uint8_t)v;
+- (void)appendUInt32LE:(uint32_t)v;
+- (void)appendInt64LE:(int64_t)v;
+- (void)appendFloat64LE:(double)v;
+
+// u32 byte length followed by the UTF-8 bytes. nil is written as an empty string.
+- (void)appendStringLE:(NSString *)s;
+
+@end
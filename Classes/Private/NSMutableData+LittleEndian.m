@@ -0,0 +1,44 @@
+//
+//  NSMutableData+LittleEndian.m
+//  Airbitz
+//
+//  Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "NSMutableData+LittleEndian.h"
+
+@implementation NSMutableData (LittleEndian)
+
+- (void)appendUInt8:(uint8_t)v
+{
+    [self appendBytes:&v length:1];
+}
+
+- (void)appendUInt32LE:(uint32_t)v
+{
+    v = CFSwapInt32HostToLittle(v);
+    [self appendBytes:&v length:sizeof(v)];
+}
+
+- (void)appendInt64LE:(int64_t)v
+{
+    uint64_t u = CFSwapInt64HostToLittle((uint64_t) v);
+    [self appendBytes:&u length:sizeof(u)];
+}
+
+- (void)appendFloat64LE:(double)v
+{
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    u = CFSwapInt64HostToLittle(u);
+    [self appendBytes:&u length:sizeof(u)];
+}
+
+- (void)appendStringLE:(NSString *)s
+{
+    NSData *utf8 = [s ? s : @"" dataUsingEncoding:NSUTF8StringEncoding];
+    [self appendUInt32LE:(uint32_t) [utf8 length]];
+    [self appendData:utf8];
+}
+
+@end
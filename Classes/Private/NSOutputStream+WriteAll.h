@@ -0,0 +1,19 @@
+//
+//  NSOutputStream+WriteAll.h
+//  Airbitz
+//
+//  Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+//
+// Blocking write of a whole buffer. Shared by the CSV/QBO exports and the columnar
+// export so both stream their output the same way.
+//
+@interface NSOutputStream (WriteAll)
+
+// Writes len bytes in bounded pieces, retrying partial writes. NO if the stream fails.
+- (BOOL)writeAll:(const void *)bytes length:(NSUInteger)len;
+
+@end
@@ -0,0 +1,29 @@
+//
+//  NSOutputStream+WriteAll.m
+//  Airbitz
+//
+//  Copyright (c) 2016 Airbitz. All rights reserved.
+//
+
+#import "NSOutputStream+WriteAll.h"
+
+// Largest single write handed to the stream
+static const NSUInteger maxWriteBytes = 64 * 1024;
+
+@implementation NSOutputStream (WriteAll)
+
+- (BOOL)writeAll:(const void *)bytes length:(NSUInteger)len
+{
+    const uint8_t *p = bytes;
+    while (len > 0)
+    {
+        NSInteger written = [self write:p maxLength:len < maxWriteBytes ? len : maxWriteBytes];
+        if (written <= 0)
+            return NO;
+        p += written;
+        len -= written;
+    }
+    return YES;
+}
+
+@end
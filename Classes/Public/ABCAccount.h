@@ -31,6 +31,9 @@
 @class ABCWallet;
 @class ABCBitIDSignature;
 @class ABCEdgeLoginInfo;
+@class ABCDataSyncStats;
+@class ABCTimelineFilter;
+@class ABCWalletEvents;
 @protocol ABCAccountDelegate;
 
 #define DUMMY_EDGE_LOGIN_TOKEN_AUGUR @"EDGYAUGUR1"
@@ -45,6 +48,46 @@
 @property                   int                         hLobby;
 @end
 
+/// Results of one wallet + account data sync cycle
+@interface ABCDataSyncStats : NSObject
+@property (atomic)          int                         walletsSynced;
+@property (atomic)          int                         walletsDirty;
+@property (atomic)          int                         walletsFailed;
+@property (atomic)          int                         walletsSkipped;
+@property (atomic)          int                         workerCount;
+@property (atomic)          NSTimeInterval              wallTime;
+@end
+
+/// Events for one wallet collected over one coalescing window.
+/// See [ABCAccountDelegate abcAccountWalletEvents:]
+@interface ABCWalletEvents : NSObject
+@property (atomic, strong)  ABCWallet                   *wallet;
+/// ABCTransaction objects for abcAccountIncomingBitcoin:transaction: events, oldest event first
+@property (atomic, strong)  NSArray                     *incomingTransactions;
+/// ABCTransaction objects for abcAccountBalanceUpdate:transaction: events, oldest event first
+@property (atomic, strong)  NSArray                     *balanceUpdateTransactions;
+/// YES if the wallet's block height changed
+@property (atomic)          BOOL                        blockHeightChanged;
+/// YES if any of the wallet's transactions changed state, ie. confirmed
+@property (atomic)          BOOL                        transactionsUpdated;
+@end
+
+typedef NS_ENUM(NSUInteger, ABCTimelineDirection) {
+    ABCTimelineDirectionAll,
+    ABCTimelineDirectionIncoming,
+    ABCTimelineDirectionOutgoing,
+};
+
+/// Filter for [ABCAccount getTimelineOffset:limit:filter:]
+@interface ABCTimelineFilter : NSObject
+/// Include transactions from archived wallets. Default NO
+@property (atomic)          BOOL                        includeArchived;
+/// Only include transactions whose category starts with this string. ie. "Expense:"
+@property (atomic, copy)    NSString                    *category;
+/// Only include incoming or outgoing transactions. Default ABCTimelineDirectionAll
+@property (atomic)          ABCTimelineDirection        direction;
+@end
+
 @interface ABCAccount : NSObject
 ///----------------------------------------------------------
 /// @name ABCAccount read/write public object variables
@@ -108,6 +151,12 @@
 /// This account's username
 @property (atomic, copy)     NSString                *name;
 
+/// Number of wallets synced in parallel during each data sync cycle. Defaults to 4.
+@property (atomic)           int                     dataSyncWorkerCount;
+
+/// Stats from the most recently completed data sync cycle. nil until the first one finishes.
+@property (atomic, strong)   ABCDataSyncStats        *lastDataSyncStats;
+
 - (void)makeCurrentWallet:(ABCWallet *)wallet;
 - (void)makeCurrentWalletWithIndex:(NSIndexPath *)indexPath;
 - (void)makeCurrentWalletWithUUID:(NSString *)uuid;
@@ -414,6 +463,76 @@
  */
 - (BOOL) shouldAskUserToEnableTouchID;
 
+/**
+ * Returns the current data sync interval for a wallet. Wallets that keep syncing
+ * with no remote changes back off up to 10 minutes. Any change, local or remote,
+ * drops the interval back to its 30 second base.
+ * @param uuid NSString UUID of wallet
+ * @return NSTimeInterval seconds between syncs of this wallet
+ */
+- (NSTimeInterval)dataSyncIntervalForWallet:(NSString *)uuid;
+
+/**
+ * Returns the current data sync interval for the account repo.
+ * @return NSTimeInterval seconds between syncs of the account
+ */
+- (NSTimeInterval)dataSyncIntervalForAccount;
+
+/**
+ * Releases the in-memory transactions of wallets other than the current wallet that have
+ * not been accessed recently. They are reloaded from the core on the next access to
+ * [ABCWallet arrayTransactions]. This is also done automatically under memory pressure.
+ * Apps may call this from didReceiveMemoryWarning.
+ */
+- (void)evictIdleWalletTransactions;
+
+/**
+ * Total satoshis sent from all non-archived wallets on the last 'days' calendar days
+ * including today. See [ABCWallet getTotalSentInLastDays:]
+ */
+- (int64_t)getTotalSentInLastDays:(NSUInteger)days;
+
+/**
+ * Total satoshis sent from all non-archived wallets in the last 'hours' hours.
+ * See [ABCWallet getTotalSentInLastHours:]
+ */
+- (int64_t)getTotalSentInLastHours:(double)hours;
+
+/**
+ * Searches the transactions of all non-archived wallets.
+ * See [ABCWallet searchTransactions:limit:]
+ * @param term NSString Search term
+ * @param limit NSUInteger Maximum number of results. 0 for no limit
+ * @return NSArray Matching ABCTransaction objects from all wallets, newest first
+ */
+- (NSArray *)searchTransactions:(NSString *)term limit:(NSUInteger)limit;
+
+/**
+ * Returns a page of the transactions of all wallets merged into one list, newest first.
+ * The merged list is cached and is updated only for wallets whose transactions changed
+ * since the last call. Wallets whose transactions are not loaded yet start loading in the
+ * background and join the timeline once abcAccountWalletChanged: reports them.
+ * @param offset NSUInteger Number of matching transactions to skip
+ * @param limit NSUInteger Maximum number of transactions to return. 0 for no limit
+ * @param filter ABCTimelineFilter Filter to apply, or nil for all non-archived wallets
+ * @return NSArray Array of ABCTransaction objects
+ */
+- (NSArray *)getTimelineOffset:(NSUInteger)offset
+                         limit:(NSUInteger)limit
+                        filter:(ABCTimelineFilter *)filter;
+
+/**
+ * Returns the combined balance of all non-archived wallets over time, downsampled
+ * for charting. Wallets whose transactions are still loading are left out until
+ * abcAccountWalletChanged: reports them. See [ABCWallet getBalanceHistoryFrom:to:interval:]
+ * @param start NSDate* Start of the series. Must not be nil
+ * @param end NSDate* End of the series or nil for now
+ * @param interval NSTimeInterval Bucket width in seconds. Widened if [start, end)
+ *  would need more than 10000 buckets
+ * @return NSArray Array of ABCBalancePoint, oldest first
+ */
+- (NSArray *)getBalanceHistoryFrom:(NSDate *)start to:(NSDate *)end interval:(NSTimeInterval)interval;
+
 ///----------------------------------------------------------
 /// @name BitID methods
 ///----------------------------------------------------------
@@ -507,6 +626,13 @@
 /// @param transaction ABCTransaction The transaction which caused the incoming coin.
 - (void) abcAccountIncomingBitcoin:(ABCWallet *)wallet transaction:(ABCTransaction *)transaction;
 
+/// Blockchain events are collected for a short window, the wallets are refreshed once,
+/// and then the events are delivered. If implemented, this is called once per window
+/// with every wallet's events, and abcAccountIncomingBitcoin:transaction:,
+/// abcAccountBalanceUpdate:transaction: and abcAccountBlockHeightChanged: are not called.
+/// @param walletEvents NSArray of ABCWalletEvents, one per wallet with events
+- (void) abcAccountWalletEvents:(NSArray *)walletEvents;
+
 @end
 
 
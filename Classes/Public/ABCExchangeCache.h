@@ -15,6 +15,18 @@
 
 #define ABCArrayExchanges     @[@"Bitstamp", @"Bitfinex", @"BitcoinAverage", @"BraveNewCoin", @"Coinbase"]
 
+/// Results of the most recent exchange rate update
+@interface ABCExchangeRateStats : NSObject
+/// Currencies fetched from the exchange servers
+@property (atomic)          int                         currenciesRequested;
+/// Currencies skipped because their rate was younger than its TTL
+@property (atomic)          int                         currenciesFresh;
+@property (atomic)          int                         currenciesFailed;
+/// Longest single currency fetch
+@property (atomic)          NSTimeInterval              slowestFetchTime;
+@property (atomic)          NSTimeInterval              wallTime;
+@end
+
 /**
  * ABCExchangeCache provides conversion routines to convert from any fiat currency
  * to BTC in satoshis or vice version. This object uses the exchange rate source
@@ -24,6 +36,17 @@
 
 @interface ABCExchangeCache : NSObject
 
+/// Stats from the most recently completed exchange rate update. nil until the first one finishes.
+@property (atomic, strong)   ABCExchangeRateStats       *lastUpdateStats;
+
+/**
+ * Sets how long a fetched rate for currencyCode is used before it is fetched again.
+ * Pass 0 to go back to the default of half the exchange rate refresh interval.
+ * @param ttl NSTimeInterval Time to live in seconds
+ * @param currencyCode NSString* ISO currency code. ie "USD, CAD, EUR"
+ */
+- (void)setRateTTL:(NSTimeInterval)ttl forCurrencyCode:(NSString *)currencyCode;
+
 /**
  * Convert bitcoin amount in satoshis to a fiat currency amount
  * @param satoshi uint_64t amount to convert in satoshis
@@ -48,6 +71,27 @@
                   currencyCode:(NSString *)currencyCode
                          error:(ABCError **)error;
 
+/**
+ * Returns the exchange rate, in fiat per BTC, recorded closest before date. History is
+ * recorded on disk each time rates are refreshed, at most one entry per 15 minutes.
+ * @param date NSDate* Point in time
+ * @param currencyCode NSString* ISO currency code. ie "USD, CAD, EUR"
+ * @return double Rate or 0 if date is before the first recorded rate for the currency
+ */
+- (double)rateAtDate:(NSDate *)date currencyCode:(NSString *)currencyCode;
+
+/**
+ * Values each transaction's amountSatoshi in fiat at the recorded rate of its date.
+ * Transactions dated before the first recorded rate are valued at 0.
+ * The rate history is walked once for a date sorted array such as
+ * [ABCWallet arrayTransactions].
+ * @param transactions NSArray* Array of ABCTransaction
+ * @param currencyCode NSString* ISO currency code. ie "USD, CAD, EUR"
+ * @return NSArray* NSNumber double fiat values, one per transaction in the same order
+ */
+- (NSArray *)historicalCurrencyValuesForTransactions:(NSArray *)transactions
+                                        currencyCode:(NSString *)currencyCode;
+
 
 @end
 
@@ -20,6 +20,12 @@ typedef NS_ENUM(NSUInteger, ABCImportDataModel) {
 @class ABCSpend;
 @class ABCTransaction;
 
+/// One point of a balance history series. See [ABCWallet getBalanceHistoryFrom:to:interval:]
+@interface ABCBalancePoint : NSObject
+@property (nonatomic, strong)   NSDate          *date;
+@property (nonatomic, assign)   SInt64          balance;
+@end
+
 /**
  * ABCWallet represents a single HD, multiple address, wallet within an ABCAccount.
  * This object is the basis for Sends and Requests. Initiate sends by calling
@@ -50,9 +56,14 @@ typedef NS_ENUM(NSUInteger, ABCImportDataModel) {
 /// The total balance of this wallet in satoshis
 @property (nonatomic, assign)   int64_t         balance;
 
-/// Array of ABCTransaction objects in this wallet
+/// Array of ABCTransaction objects in this wallet, newest first. The first access starts
+/// loading them in the background and returns an empty array. When they are loaded
+/// [ABCAccountDelegate abcAccountWalletChanged:] is called. See transactionsLoaded
 @property (nonatomic, strong)   NSArray         *arrayTransactions;
 
+/// YES once arrayTransactions holds the wallet's transactions
+- (BOOL)transactionsLoaded;
+
 /// YES if this wallet and it's transactions have been loaded. This is NO on initial
 /// signIn while wallet info is being decrypted and loaded
 @property (nonatomic, assign)   BOOL            loaded;
@@ -106,12 +117,78 @@ typedef NS_ENUM(NSUInteger, ABCImportDataModel) {
 /**
  * Searches transactions in wallet for any transactions with metadata
  * matching term and returns the matching transactions in arrayTransactions
+ * newest first. The search is done by the core, which matches term as a substring.
+ * For a faster search on every keystroke use searchTransactions:limit:
  * @param term NSString Search term
  * @param arrayTransactions Allocated NSMutableArray for the resulting matching transactions
  * @return ABCError Error object
  */
 - (ABCError *)searchTransactionsIn:(NSString *)term addTo:(NSMutableArray *) arrayTransactions;
 
+/**
+ * Searches the wallet's transactions using a local index over payee name, category,
+ * notes, txid, addresses and amount. Amounts are indexed in satoshis, BTC, mBTC and
+ * bits. Each word of term is matched as the start of a word, not as an arbitrary
+ * substring as searchTransactionsIn:addTo: does, and all words must match. Does not call into
+ * the core so it is cheap enough to run on every keystroke. The index is built in the
+ * background once the transactions are loaded. Until then this starts the load and returns
+ * no results, and abcAccountWalletChanged: is sent when the wallet can be searched.
+ * @param term NSString Search term
+ * @param limit NSUInteger Maximum number of results. 0 for no limit
+ * @return NSArray Matching ABCTransaction objects, newest first
+ */
+- (NSArray *)searchTransactions:(NSString *)term limit:(NSUInteger)limit;
+
+/**
+ * Returns the wallet balance over time, downsampled for charting. [start, end) is
+ * divided into buckets 'interval' seconds wide, and each bucket contributes at most
+ * three points: its lowest, highest and closing balance, in time order. Short spikes
+ * stay visible at any resolution. The series begins with a point at start and ends
+ * with a point at end. The result is cached per start and interval. When new
+ * transactions arrive, only the buckets they touch are recomputed.
+ * @param start NSDate* Start of the series. Must not be nil
+ * @param end NSDate* End of the series or nil for now
+ * @param interval NSTimeInterval Bucket width in seconds. Widened if [start, end)
+ *  would need more than 10000 buckets
+ * @return NSArray Array of ABCBalancePoint, oldest first
+ */
+- (NSArray *)getBalanceHistoryFrom:(NSDate *)start to:(NSDate *)end interval:(NSTimeInterval)interval;
+
+/**
+ * Returns the transactions created in [start, end), newest first, with balance set.
+ * Only the requested range is read from the core unless arrayTransactions is
+ * already loaded.
+ * @param start NSDate oldest date to include. nil for the start of the wallet
+ * @param end NSDate date to stop before. nil for no limit
+ * @param error ABCError (Optional) Error object
+ * @return NSArray of ABCTransaction or nil on error
+ */
+- (NSArray *)getTransactionsFrom:(NSDate *)start to:(NSDate *)end error:(ABCError **)error;
+
+/**
+ * Returns up to limit transactions created before the given date, newest first, with
+ * balance set. Use the date of the last transaction returned as the next cursor. A page
+ * can exceed limit so that transactions sharing a timestamp are never split.
+ * @param before NSDate cursor. nil for the newest transactions
+ * @param limit NSUInteger maximum number of transactions to return
+ * @param error ABCError (Optional) Error object
+ * @return NSArray of ABCTransaction or nil on error
+ */
+- (NSArray *)getTransactionsBefore:(NSDate *)before limit:(NSUInteger)limit error:(ABCError **)error;
+
+/**
+ * Returns up to limit transactions starting offset transactions from the newest.
+ * If arrayTransactions is not loaded, the wallet remembers where the previous page
+ * ended so that paging forward reads only the new page from the core. Jumping to
+ * an arbitrary offset still reads every transaction before it, so prefer
+ * getTransactionsBefore:limit:error: for deep paging.
+ * @param offset NSUInteger number of newest transactions to skip
+ * @param limit NSUInteger maximum number of transactions to return
+ * @param error ABCError (Optional) Error object
+ * @return NSArray of ABCTransaction or nil on error
+ */
+- (NSArray *)getTransactionsOffset:(NSUInteger)offset limit:(NSUInteger)limit error:(ABCError **)error;
+
 
 ///----------------------------------------------------------
 /// @name Bitcoin Address Creation
@@ -229,6 +306,87 @@ typedef NS_ENUM(NSUInteger, ABCImportDataModel) {
 - (ABCError *)exportTransactionsToQBO:(NSMutableString *) qbo;
 - (ABCError *)exportTransactionsToQBO:(NSMutableString *) qbo start:(NSDate *)start end:(NSDate* )end;
 
+/**
+ * Export a wallet's transactions in [start, end) to CSV format, writing to stream as the
+ * export is produced. The range is exported in time windows of a few hundred
+ * transactions each, sized from what the core returns, so memory use does not grow with
+ * the size of the wallet's history and the wallet's transactions are not loaded. Use
+ * [NSOutputStream outputStreamToFileAtPath:append:] to write directly to a file.
+ * @param stream NSOutputStream* Stream to write to. Opened if not already open. Not closed.
+ * @param start NSDate* Start of the range or nil for the beginning of the wallet
+ * @param end NSDate* End of the range or nil for no limit
+ * @param progress Called after each chunk with the fraction completed, 0.0 - 1.0. May be nil.
+ * @return NSError* error object. nil if success
+ */
+- (ABCError *)exportTransactionsToCSVStream:(NSOutputStream *)stream
+                                      start:(NSDate *)start
+                                        end:(NSDate *)end
+                                   progress:(void (^)(double progress))progress;
+
+/**
+ * Export a wallet's transactions in [start, end) to Quickbooks QBO format, writing to stream.
+ * See exportTransactionsToCSVStream:start:end:progress:. QBO is produced by the core as
+ * one document so only the writing to stream is incremental.
+ */
+- (ABCError *)exportTransactionsToQBOStream:(NSOutputStream *)stream
+                                      start:(NSDate *)start
+                                        end:(NSDate *)end
+                                   progress:(void (^)(double progress))progress;
+
+/**
+ * Export a wallet's transactions in [start, end) as newline delimited JSON, oldest first.
+ * Each line is one object with the transaction's fields, its metadata and its
+ * inputOutputList. Written in chunks like exportTransactionsToCSVStream:start:end:progress:
+ * @param stream NSOutputStream* Stream to write to. Opened if not already open. Not closed.
+ * @param start NSDate* Start of the range or nil for the beginning of the wallet
+ * @param end NSDate* End of the range or nil for no limit
+ * @param progress Called after each chunk with the fraction completed, 0.0 - 1.0. May be nil.
+ * @return NSError* error object. nil if success
+ */
+- (ABCError *)exportTransactionsToJSONLinesStream:(NSOutputStream *)stream
+                                            start:(NSDate *)start
+                                              end:(NSDate *)end
+                                         progress:(void (^)(double progress))progress;
+
+/**
+ * Export a wallet's transactions in [start, end) in a compact column oriented binary
+ * format, oldest first, one row group per chunk. The same fields as the JSON Lines export.
+ * All integers are little endian. A string is a u32 byte length followed by that many
+ * bytes of UTF-8.
+ *
+ *     header:     "ABCC" magic, u32 version (1)
+ *     row group:  u32 rowCount (> 0), then one column after another, each with
+ *                 rowCount values:
+ *                   txid           string
+ *                   timestamp      i64, unix seconds
+ *                   height         i64
+ *                   amount         i64, satoshis
+ *                   minerFees      i64
+ *                   providerFee    i64
+ *                   flags          u8, bit 0 replace-by-fee, bit 1 double spend
+ *                   payeeName      string
+ *                   category       string
+ *                   notes          string
+ *                   amountFiat     f64
+ *                   bizId          u32
+ *                   ioCount        u32
+ *                 then the ioCount total inputs/outputs, also column by column:
+ *                   address        string
+ *                   amount         i64
+ *                   isInput        u8
+ *     footer:     u32 0
+ *
+ * @param stream NSOutputStream* Stream to write to. Opened if not already open. Not closed.
+ * @param start NSDate* Start of the range or nil for the beginning of the wallet
+ * @param end NSDate* End of the range or nil for no limit
+ * @param progress Called after each chunk with the fraction completed, 0.0 - 1.0. May be nil.
+ * @return NSError* error object. nil if success
+ */
+- (ABCError *)exportTransactionsToColumnarStream:(NSOutputStream *)stream
+                                           start:(NSDate *)start
+                                             end:(NSDate *)end
+                                        progress:(void (^)(double progress))progress;
+
 /*
  * Export a wallet's private seed in raw entropy format
  * @param seed NSMutableString* allocated and initialized mutable string to receive private seed contents.
@@ -247,6 +405,23 @@ typedef NS_ENUM(NSUInteger, ABCImportDataModel) {
 
 - (void)deprioritizeAllAddresses;
 - (int64_t)getTotalSentToday;
+
+/**
+ * Total satoshis sent on the last 'days' calendar days including today, in the
+ * device's current time zone. Constant time after the first call per time zone.
+ * If the transactions are not loaded, only those days are read from the core.
+ * @param days NSUInteger number of days. 1 is the same as getTotalSentToday
+ * @return int64_t satoshis sent
+ */
+- (int64_t)getTotalSentInLastDays:(NSUInteger)days;
+
+/**
+ * Total satoshis sent in the rolling window of the last 'hours' hours
+ * @param hours double window length in hours
+ * @return int64_t satoshis sent
+ */
+- (int64_t)getTotalSentInLastHours:(double)hours;
+
 - (void)refreshServer:(BOOL)bData notify:(void(^)(void))cb;
 - (NSString *)conversionString;
 
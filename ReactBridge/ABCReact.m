@@ -391,6 +391,30 @@ RCT_EXPORT_METHOD(signBitIDRequest:(NSString *)uri
 // -------------------------------------------------------------------------------
 
 
+- (NSDictionary *)dictFromTransaction:(ABCTransaction *)tx
+{
+    NSDictionary *metaData = [[NSDictionary alloc] initWithObjectsAndKeys:
+                              @"payeeName", tx.metaData.payeeName,
+                              @"category", tx.metaData.category,
+                              @"notes", tx.metaData.notes,
+                              @"bizId", [NSNumber numberWithInteger:tx.metaData.bizId],
+                              @"amountFiat", [NSNumber numberWithDouble:tx.metaData.amountFiat],
+                              nil];
+    
+    NSDictionary *dictTx = [[NSDictionary alloc]
+                            initWithObjectsAndKeys:
+                            @"txid", tx.txid,
+                            @"amountSatoshi", [NSNumber numberWithLongLong:tx.amountSatoshi],
+                            @"date", [NSNumber numberWithLong:floor([tx.date timeIntervalSince1970] * 1000)],
+                            @"balance", [NSNumber numberWithLongLong:tx.balance],
+                            @"height", [NSNumber numberWithUnsignedLongLong:tx.height],
+                            @"isReplaceByFee", [NSNumber numberWithBool:tx.isReplaceByFee],
+                            @"isDoubleSpend", [NSNumber numberWithBool:tx.isDoubleSpend],
+                            @"metaData", metaData,
+                            nil];
+    return dictTx;
+}
+
 RCT_EXPORT_METHOD(getTransactions:(NSString *)uuid
                   complete:(RCTResponseSenderBlock)callback)
 {
@@ -403,27 +427,7 @@ RCT_EXPORT_METHOD(getTransactions:(NSString *)uuid
             {
                 for (ABCTransaction *tx in w.arrayTransactions)
                 {
-                    NSDictionary *metaData = [[NSDictionary alloc] initWithObjectsAndKeys:
-                                              @"payeeName", tx.metaData.payeeName,
-                                              @"category", tx.metaData.category,
-                                              @"notes", tx.metaData.notes,
-                                              @"bizId", [NSNumber numberWithInteger:tx.metaData.bizId],
-                                              @"amountFiat", [NSNumber numberWithDouble:tx.metaData.amountFiat],
-                                              nil];
-                    
-                    NSDictionary *dictTx = [[NSDictionary alloc]
-                                            initWithObjectsAndKeys:
-                                            @"txid", tx.txid,
-                                            @"amountSatoshi", [NSNumber numberWithLongLong:tx.amountSatoshi],
-                                            @"date", [NSNumber numberWithLong:floor([tx.date timeIntervalSince1970] * 1000)],
-                                            @"balance", [NSNumber numberWithLongLong:tx.balance],
-                                            @"height", [NSNumber numberWithUnsignedLongLong:tx.height],
-                                            @"isReplaceByFee", [NSNumber numberWithBool:tx.isReplaceByFee],
-                                            @"isDoubleSpend", [NSNumber numberWithBool:tx.isDoubleSpend],
-                                            @"metaData", metaData,
-                                            nil];
-                    
-                    [array addObject:dictTx];
+                    [array addObject:[self dictFromTransaction:tx]];
                 }
                 break;
             }
@@ -433,6 +437,45 @@ RCT_EXPORT_METHOD(getTransactions:(NSString *)uuid
     });
 }
 
+//
+// Returns up to limit transactions older than beforeDate (milliseconds since 1970, 0 for
+// the newest). Pass the date of the last transaction returned to get the next page.
+//
+RCT_EXPORT_METHOD(getTransactionsPage:(NSString *)uuid
+                  beforeDate:(nonnull NSNumber *)beforeDate
+                  limit:(nonnull NSNumber *)limit
+                  complete:(RCTResponseSenderBlock)callback)
+{
+    ABC_CHECK_ACCOUNT();
+    
+    ABCWallet *w = [abcAccount getWallet:uuid];
+    if (!w)
+    {
+        callback([self makeError:ABCConditionCodeInvalidWalletID message:@"Invalid wallet"]);
+        return;
+    }
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        ABCError *error = nil;
+        NSDate *before = [beforeDate longLongValue] > 0 ?
+            [NSDate dateWithTimeIntervalSince1970:[beforeDate doubleValue] / 1000] : nil;
+        NSArray *page = [w getTransactionsBefore:before limit:[limit unsignedIntegerValue] error:&error];
+        
+        NSMutableArray *array = [[NSMutableArray alloc] init];
+        for (ABCTransaction *tx in page)
+        {
+            [array addObject:[self dictFromTransaction:tx]];
+        }
+        
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (error)
+                callback([self makeErrorFromNSError:error]);
+            else
+                callback([self makeResponseFromObj:array]);
+        });
+    });
+}
+
 // -------------------------------------------------------------------------------
 #pragma mark - ABCDataStore methods
 // -------------------------------------------------------------------------------